@@ -0,0 +1,612 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "../src/contraction_hierarchy.h"
+#include "../src/mapped_file.h"
+#include "../src/osm_parse.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+#include "../src/xml_reader.h"
+
+// Micro-benchmarks on the bundled map. Run from the build directory:
+//   ./benchmark [-f ../map.osm] [benchmark names...]
+// Without names every benchmark runs.
+
+using Clock = std::chrono::steady_clock;
+
+// Runs f repeatedly for at least min_seconds and returns nanoseconds per call.
+template <typename F>
+static double TimePerCall(F f, double min_seconds = 0.5)
+{
+    size_t calls = 0;
+    auto start = Clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        f();
+        ++calls;
+        elapsed = Clock::now() - start;
+    } while( elapsed.count() < min_seconds );
+    return elapsed.count() * 1e9 / calls;
+}
+
+static void Report(std::string_view name, double ns_per_call, size_t items, std::string_view unit)
+{
+    std::cout << "  " << std::left << std::setw(28) << name << std::right << std::fixed
+              << std::setw(12) << std::setprecision(2) << ns_per_call / 1e6 << " ms"
+              << std::setw(10) << std::setprecision(2) << ns_per_call / items << " ns/" << unit << std::endl;
+}
+
+// Coordinate parsing: atof versus the shared osm_parse.h layer, over every
+// lat/lon attribute value in the map.
+static void BenchParse(const MappedFile &osm_data)
+{
+    auto text = reinterpret_cast<const char*>(osm_data.data());
+    XmlReader reader{text, text + osm_data.size()};
+    std::vector<std::string_view> values;
+    std::vector<std::string> terminated;
+    while( reader.Next() )
+        if( !reader.IsEndTag() && reader.Name() == "node" ) {
+            values.emplace_back(reader.Attribute("lat"));
+            values.emplace_back(reader.Attribute("lon"));
+        }
+    for( auto value: values )
+        terminated.emplace_back(value);
+    std::cout << "parse: " << values.size() << " coordinates" << std::endl;
+
+    size_t mismatches = 0;
+    for( size_t i = 0; i < values.size(); ++i ) {
+        double parsed;
+        if( !ParseCoordinate(values[i], parsed) || parsed != atof(terminated[i].c_str()) )
+            ++mismatches;
+    }
+
+    volatile double sink = 0.;
+    auto atof_ns = TimePerCall([&]{
+        double sum = 0.;
+        for( auto &value: terminated )
+            sum += atof(value.c_str());
+        sink = sum;
+    });
+    auto from_chars_ns = TimePerCall([&]{
+        double sum = 0.;
+        for( auto value: values ) {
+            double parsed = 0.;
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+            sum += parsed;
+        }
+        sink = sum;
+    });
+    auto coordinate_ns = TimePerCall([&]{
+        double sum = 0.;
+        for( auto value: values ) {
+            double parsed = 0.;
+            ParseCoordinate(value, parsed);
+            sum += parsed;
+        }
+        sink = sum;
+    });
+    Report("atof", atof_ns, values.size(), "value");
+    Report("std::from_chars", from_chars_ns, values.size(), "value");
+    Report("ParseCoordinate", coordinate_ns, values.size(), "value");
+    std::cout << "  speedup over atof: " << std::setprecision(2) << atof_ns / coordinate_ns
+              << "x, results differing from atof: " << mismatches << std::endl;
+}
+
+// The open list as it was before the indexed heap: a vector that is fully
+// sorted by g + h before every pop. Returns the path length in model units.
+static float SortedListSearch(const RouteModel &model, SearchWorkspace &workspace, int start, int end)
+{
+    auto &graph = model.Graph();
+    auto &nodes = model.Nodes();
+    std::vector<int> open;
+    workspace.Reset((int)nodes.size());
+    workspace.Visit(start);
+    workspace.GValue(start) = 0.f;
+    workspace.HValue(start) = RouteModel::Distance(nodes[start], nodes[end]);
+    open.push_back(start);
+    while( !open.empty() ) {
+        std::sort(open.begin(), open.end(), [&](int a, int b) {
+            return workspace.GValue(a) + workspace.HValue(a) > workspace.GValue(b) + workspace.HValue(b);
+        });
+        int current = open.back();
+        open.pop_back();
+        if( current == end )
+            return workspace.GValue(current);
+        auto targets = graph.Targets(current);
+        auto lengths = graph.Lengths(current);
+        for( size_t i = 0; i < targets.size(); ++i ) {
+            float g_value = workspace.GValue(current) + lengths[i];
+            if( !workspace.Visited(targets[i]) ) {
+                workspace.Visit(targets[i]);
+                workspace.GValue(targets[i]) = g_value;
+                workspace.HValue(targets[i]) = RouteModel::Distance(nodes[targets[i]], nodes[end]);
+                open.push_back(targets[i]);
+            }
+            else if( g_value < workspace.GValue(targets[i]) )
+                workspace.GValue(targets[i]) = g_value;
+        }
+    }
+    return 0.f;
+}
+
+using Query = std::array<float, 4>;
+
+// Start and end points as percentages of the map, the planner's input.
+static std::vector<Query> RandomQueries(size_t count)
+{
+    std::mt19937 rng{1};
+    std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+    std::vector<Query> queries(count);
+    for( auto &query: queries )
+        query = {coordinate(rng), coordinate(rng), coordinate(rng), coordinate(rng)};
+    return queries;
+}
+
+// Point-to-point A* latency: the sort-based open list against RoutePlanner's
+// indexed heap, over the same random queries.
+static void BenchRoute(const MappedFile &osm_data)
+{
+    RouteModel model{osm_data.Bytes()};
+    auto queries = RandomQueries(64);
+    std::cout << "route: " << queries.size() << " queries on " << model.Graph().NodeCount() << " nodes" << std::endl;
+
+    SearchWorkspace workspace;
+    size_t mismatches = 0;
+    for( auto &[start_x, start_y, end_x, end_y]: queries ) {
+        RoutePlanner planner{model, workspace, start_x, start_y, end_x, end_y};
+        planner.AStarSearch();
+        int start = model.FindClosestNode(start_x * 0.01f, start_y * 0.01f).Index();
+        int end = model.FindClosestNode(end_x * 0.01f, end_y * 0.01f).Index();
+        float sorted = SortedListSearch(model, workspace, start, end) * model.MetricScale();
+        if( std::abs(sorted - planner.GetDistance()) > 1e-3f * std::max(1.f, sorted) )
+            ++mismatches;
+    }
+
+    // Endpoints are snapped up front so that only the searches are timed.
+    std::vector<std::pair<int, int>> endpoints;
+    std::vector<std::unique_ptr<RoutePlanner>> planners;
+    for( auto &[start_x, start_y, end_x, end_y]: queries ) {
+        endpoints.emplace_back(model.FindClosestNode(start_x * 0.01f, start_y * 0.01f).Index(),
+                               model.FindClosestNode(end_x * 0.01f, end_y * 0.01f).Index());
+        planners.emplace_back(std::make_unique<RoutePlanner>(model, workspace, start_x, start_y, end_x, end_y));
+    }
+    volatile float sink = 0.f;
+    auto sorted_ns = TimePerCall([&]{
+        for( auto [start, end]: endpoints )
+            sink = SortedListSearch(model, workspace, start, end);
+    });
+    auto heap_ns = TimePerCall([&]{
+        for( auto &planner: planners ) {
+            planner->AStarSearch();
+            sink = planner->GetDistance();
+        }
+    });
+    Report("sorted open list", sorted_ns, queries.size(), "query");
+    Report("RoutePlanner (4-ary heap)", heap_ns, queries.size(), "query");
+    std::cout << "  speedup over sorted list: " << std::setprecision(2) << sorted_ns / heap_ns
+              << "x, distances differing: " << mismatches << std::endl;
+}
+
+// Runs the queries with the given open list backend. Planners, and so endpoint
+// snapping, are set up outside the timed loop; returns nanoseconds per batch.
+template <typename Queue>
+static double TimeQueue(const RouteModel &model, const std::vector<Query> &queries, std::vector<float> &distances)
+{
+    BasicSearchWorkspace<Queue> workspace;
+    std::vector<std::unique_ptr<BasicRoutePlanner<Queue>>> planners;
+    for( auto &[start_x, start_y, end_x, end_y]: queries )
+        planners.emplace_back(std::make_unique<BasicRoutePlanner<Queue>>(model, workspace, start_x, start_y, end_x, end_y));
+    distances.clear();
+    for( auto &planner: planners ) {
+        planner->AStarSearch();
+        distances.push_back(planner->GetDistance());
+    }
+    return TimePerCall([&]{
+        for( auto &planner: planners )
+            planner->AStarSearch();
+    });
+}
+
+// The open list backends of BasicRoutePlanner on the same random queries, with
+// the largest distance difference to the exact 4-ary heap.
+static void BenchQueues(const MappedFile &osm_data)
+{
+    RouteModel model{osm_data.Bytes()};
+    auto queries = RandomQueries(256);
+    std::cout << "queues: " << queries.size() << " queries on " << model.Graph().NodeCount() << " nodes" << std::endl;
+
+    std::vector<float> reference, distances;
+    auto report = [&](std::string_view name, double ns) {
+        float deviation = 0.f;
+        for( size_t i = 0; i < queries.size(); ++i )
+            deviation = std::max(deviation, std::abs(distances[i] - reference[i]));
+        Report(name, ns, queries.size(), "query");
+        std::cout << "    largest distance difference: " << std::setprecision(3) << deviation << " m" << std::endl;
+    };
+    auto heap_ns = TimeQueue<IndexedHeap>(model, queries, reference);
+    distances = reference;
+    report("4-ary indexed heap", heap_ns);
+    report("pairing heap", TimeQueue<PairingHeap>(model, queries, distances));
+    report("radix heap", TimeQueue<RadixHeap>(model, queries, distances));
+    report("bucket queue", TimeQueue<BucketQueue>(model, queries, distances));
+}
+
+// Forward against bidirectional A* on the same random queries: latency and
+// nodes settled, over all queries and over the longest quarter of the routes.
+static void BenchBidirectional(const MappedFile &osm_data)
+{
+    RouteModel model{osm_data.Bytes()};
+    auto queries = RandomQueries(256);
+    std::cout << "bidirectional: " << queries.size() << " queries on " << model.Graph().NodeCount() << " nodes" << std::endl;
+
+    using Mode = RoutePlanner::SearchMode;
+    SearchWorkspace workspace;
+    std::vector<std::unique_ptr<RoutePlanner>> planners;
+    for( auto &[start_x, start_y, end_x, end_y]: queries )
+        planners.emplace_back(std::make_unique<RoutePlanner>(model, workspace, start_x, start_y, end_x, end_y));
+
+    std::vector<float> lengths;
+    for( auto &planner: planners ) {
+        planner->AStarSearch();
+        lengths.push_back(planner->GetDistance());
+    }
+    std::vector<float> sorted = lengths;
+    std::sort(sorted.begin(), sorted.end());
+    float long_route = sorted[sorted.size() * 3 / 4];
+
+    size_t mismatches = 0;
+    for( auto mode: {Mode::Forward, Mode::Bidirectional} ) {
+        size_t settled = 0, long_settled = 0;
+        for( size_t i = 0; i < planners.size(); ++i ) {
+            planners[i]->AStarSearch(mode);
+            settled += planners[i]->GetSettledCount();
+            if( lengths[i] >= long_route )
+                long_settled += planners[i]->GetSettledCount();
+            if( std::abs(planners[i]->GetDistance() - lengths[i]) > 1e-3f )
+                ++mismatches;
+        }
+        auto ns = TimePerCall([&]{
+            for( auto &planner: planners )
+                planner->AStarSearch(mode);
+        });
+        Report(mode == Mode::Forward ? "forward A*" : "bidirectional A*", ns, queries.size(), "query");
+        std::cout << "    settled per query: " << std::setprecision(0) << (double)settled / queries.size()
+                  << ", on routes over " << long_route << " m: " << (double)long_settled / (queries.size() / 4) << std::endl;
+    }
+    std::cout << "  distances differing: " << mismatches << std::endl;
+}
+
+// ALT landmarks: table build time, then A* latency and nodes settled with the
+// straight-line heuristic and with 16 landmarks, on the same random queries.
+static void BenchLandmarks(const MappedFile &osm_data)
+{
+    RouteModel model{osm_data.Bytes()};
+    auto queries = RandomQueries(256);
+    std::cout << "landmarks: " << queries.size() << " queries on " << model.Graph().NodeCount() << " nodes" << std::endl;
+
+    Landmarks landmarks;
+    auto build_ns = TimePerCall([&]{ landmarks = Landmarks{model.Graph(), 16}; });
+    Report("build 16 landmarks", build_ns, model.Graph().NodeCount(), "node");
+
+    SearchWorkspace workspace;
+    std::vector<std::unique_ptr<RoutePlanner>> planners;
+    for( auto &[start_x, start_y, end_x, end_y]: queries )
+        planners.emplace_back(std::make_unique<RoutePlanner>(model, workspace, start_x, start_y, end_x, end_y));
+    std::vector<float> lengths;
+    for( auto &planner: planners ) {
+        planner->AStarSearch();
+        lengths.push_back(planner->GetDistance());
+    }
+
+    size_t mismatches = 0;
+    for( const Landmarks *heuristic: {(const Landmarks *)nullptr, (const Landmarks *)&landmarks} ) {
+        size_t settled = 0;
+        for( size_t i = 0; i < planners.size(); ++i ) {
+            planners[i]->SetLandmarks(heuristic);
+            planners[i]->AStarSearch();
+            settled += planners[i]->GetSettledCount();
+            if( std::abs(planners[i]->GetDistance() - lengths[i]) > 1e-3f )
+                ++mismatches;
+        }
+        auto ns = TimePerCall([&]{
+            for( auto &planner: planners )
+                planner->AStarSearch();
+        });
+        Report(heuristic ? "A* with landmarks" : "A* straight line", ns, queries.size(), "query");
+        std::cout << "    settled per query: " << std::setprecision(0) << (double)settled / queries.size() << std::endl;
+    }
+    std::cout << "  distances differing: " << mismatches << std::endl;
+}
+
+// The scan FindClosestNode did before the k-d tree: every node of every
+// non-footway road, for each lookup.
+static int ScanClosestNode(const RouteModel &model, float x, float y)
+{
+    Model::Node input{x, y};
+    float min_dist = std::numeric_limits<float>::max();
+    int closest_idx = -1;
+    for( const Model::Road &road: model.Roads() )
+        if( road.type != Model::Road::Type::Footway )
+            for( int node_idx: model.Ways()[road.way].nodes ) {
+                float dist = RouteModel::Distance(input, model.Nodes()[node_idx]);
+                if( dist < min_dist ) {
+                    closest_idx = node_idx;
+                    min_dist = dist;
+                }
+            }
+    return closest_idx;
+}
+
+// Snapping query points to the road network: the linear scan against the
+// k-d tree, for the nearest node and the 8 nearest, and projecting onto the
+// nearest segment through the segment grid.
+static void BenchSnap(const MappedFile &osm_data)
+{
+    RouteModel model{osm_data.Bytes()};
+    auto queries = RandomQueries(1024);
+    std::cout << "snap: " << queries.size() << " points, " << model.Stats().Memory(LoadStats::Container::SpatialIndex).count
+              << " routable nodes, index built in " << std::fixed << std::setprecision(2)
+              << model.Stats().Seconds(LoadStats::Phase::SpatialIndex) * 1e3 << " ms" << std::endl;
+
+    size_t mismatches = 0;
+    double node_offset = 0., edge_offset = 0.;
+    for( auto &query: queries ) {
+        auto tree = model.FindClosestNode(query[0] * 0.01f, query[1] * 0.01f).Position();
+        auto scan = model.Nodes()[ScanClosestNode(model, query[0] * 0.01f, query[1] * 0.01f)];
+        Model::Node input{query[0] * 0.01f, query[1] * 0.01f};
+        if( RouteModel::Distance(input, tree) != RouteModel::Distance(input, scan) )
+            ++mismatches;
+        node_offset += RouteModel::Distance(input, tree);
+        edge_offset += model.SnapToEdge(input.x, input.y).distance;
+    }
+
+    volatile int sink = 0;
+    auto scan_ns = TimePerCall([&]{
+        for( auto &query: queries )
+            sink = ScanClosestNode(model, query[0] * 0.01f, query[1] * 0.01f);
+    });
+    auto tree_ns = TimePerCall([&]{
+        for( auto &query: queries )
+            sink = model.FindClosestNode(query[0] * 0.01f, query[1] * 0.01f).Index();
+    });
+    auto nearest_ns = TimePerCall([&]{
+        for( auto &query: queries )
+            sink = model.FindClosestNodes(query[0] * 0.01f, query[1] * 0.01f, 8).back().Index();
+    });
+    auto edge_ns = TimePerCall([&]{
+        for( auto &query: queries )
+            sink = model.SnapToEdge(query[0] * 0.01f, query[1] * 0.01f).from;
+    });
+    Report("linear scan", scan_ns, queries.size(), "point");
+    Report("k-d tree", tree_ns, queries.size(), "point");
+    Report("k-d tree, 8 nearest", nearest_ns, queries.size(), "point");
+    Report("segment grid, to edge", edge_ns, queries.size(), "point");
+
+    // Bulk snapping of GPS traces: many points, in no particular order.
+    std::mt19937 rng{5};
+    std::uniform_real_distribution<float> coordinate{0.f, 1.f};
+    std::vector<float> xs(100000), ys(xs.size()), distances(xs.size());
+    std::vector<int> nodes(xs.size());
+    for( size_t i = 0; i < xs.size(); ++i ) {
+        xs[i] = coordinate(rng);
+        ys[i] = coordinate(rng);
+    }
+    auto single_ns = TimePerCall([&]{
+        for( size_t i = 0; i < xs.size(); ++i )
+            nodes[i] = model.FindClosestNode(xs[i], ys[i]).Index();
+    });
+    auto batch_ns = TimePerCall([&]{ model.SnapToNodes(xs, ys, nodes, distances); });
+    Report("k-d tree, one by one", single_ns, xs.size(), "point");
+    Report("k-d tree, SnapToNodes", batch_ns, xs.size(), "point");
+
+    // The same over every node of the map, a tree ten times the size.
+    std::vector<KdTree::Point> points;
+    auto &model_nodes = model.Nodes();
+    for( size_t i = 0; i < model_nodes.size(); ++i )
+        points.push_back({(float)model_nodes.X(i), (float)model_nodes.Y(i), (int)i});
+    KdTree all_nodes{std::move(points)};
+    auto all_single_ns = TimePerCall([&]{
+        for( size_t i = 0; i < xs.size(); ++i )
+            nodes[i] = all_nodes.Nearest(xs[i], ys[i]);
+    });
+    auto all_batch_ns = TimePerCall([&]{ all_nodes.Nearest(xs, ys, nodes, distances); });
+    Report("all nodes, one by one", all_single_ns, xs.size(), "point");
+    Report("all nodes, batch", all_batch_ns, xs.size(), "point");
+    std::cout << "  speedup over scan: " << std::setprecision(2) << scan_ns / tree_ns
+              << "x, distances differing: " << mismatches << ", batch speedup: " << single_ns / batch_ns << "x" << std::endl;
+    std::cout << "  mean snap distance: " << std::setprecision(1) << node_offset / queries.size() * model.MetricScale()
+              << " m to a node, " << edge_offset / queries.size() * model.MetricScale() << " m to an edge" << std::endl;
+}
+
+// Contraction hierarchies: preprocessing time and size, then query latency and
+// nodes settled against A* on the same random queries.
+static void BenchContractionHierarchy(const MappedFile &osm_data)
+{
+    RouteModel model{osm_data.Bytes()};
+    auto queries = RandomQueries(256);
+    std::cout << "ch: " << queries.size() << " queries on " << model.Graph().NodeCount() << " nodes, "
+              << model.Graph().EdgeCount() << " edges" << std::endl;
+
+    // Thread counts past the hardware's only measure the pool's overhead.
+    ContractionHierarchy hierarchy;
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> thread_counts{1, 2, 4, hardware};
+    std::sort(thread_counts.begin(), thread_counts.end());
+    thread_counts.erase(std::unique(thread_counts.begin(), thread_counts.end()), thread_counts.end());
+    double sequential_ns = 0.;
+    for( unsigned threads: thread_counts ) {
+        auto build_ns = TimePerCall([&]{ hierarchy = ContractionHierarchy{model.Graph(), threads}; });
+        if( threads == 1 )
+            sequential_ns = build_ns;
+        Report("contract, " + std::to_string(threads) + (threads == 1 ? " thread" : " threads"), build_ns,
+               model.Graph().NodeCount(), "node");
+        std::cout << "    speedup: " << std::setprecision(2) << sequential_ns / build_ns << "x" << std::endl;
+    }
+    std::cout << "    hardware threads: " << hardware << std::endl;
+    std::cout << "    shortcuts: " << hierarchy.ShortcutCount() << ", " << hierarchy.Bytes() / 1024 << " KiB" << std::endl;
+
+    SearchWorkspace workspace;
+    std::vector<std::unique_ptr<RoutePlanner>> planners;
+    std::vector<std::unique_ptr<CHPlanner>> ch_planners;
+    for( auto &[start_x, start_y, end_x, end_y]: queries ) {
+        planners.emplace_back(std::make_unique<RoutePlanner>(model, workspace, start_x, start_y, end_x, end_y));
+        ch_planners.emplace_back(std::make_unique<CHPlanner>(model, hierarchy, workspace, start_x, start_y, end_x, end_y));
+    }
+    size_t mismatches = 0, settled = 0, ch_settled = 0;
+    for( size_t i = 0; i < queries.size(); ++i ) {
+        planners[i]->AStarSearch();
+        ch_planners[i]->Search();
+        settled += planners[i]->GetSettledCount();
+        ch_settled += ch_planners[i]->GetSettledCount();
+        if( std::abs(planners[i]->GetDistance() - ch_planners[i]->GetDistance()) > 1e-2f )
+            ++mismatches;
+    }
+
+    auto astar_ns = TimePerCall([&]{
+        for( auto &planner: planners )
+            planner->AStarSearch();
+    });
+    auto ch_ns = TimePerCall([&]{
+        for( auto &planner: ch_planners )
+            planner->Search();
+    });
+    Report("A*", astar_ns, queries.size(), "query");
+    std::cout << "    settled per query: " << std::setprecision(0) << (double)settled / queries.size() << std::endl;
+    Report("CH query", ch_ns, queries.size(), "query");
+    std::cout << "    settled per query: " << std::setprecision(0) << (double)ch_settled / queries.size() << std::endl;
+    std::cout << "  speedup over A*: " << std::setprecision(2) << astar_ns / ch_ns
+              << "x, distances differing: " << mismatches << std::endl;
+}
+
+// What a search between two components cost before they were labelled: A*
+// finds no route only after settling every node reachable from the start.
+// Returns the nodes settled.
+static size_t ExhaustComponent(const RouteModel &model, SearchWorkspace &workspace, int start, int end)
+{
+    auto &graph = model.Graph();
+    auto &nodes = model.Nodes();
+    workspace.Reset((int)nodes.size());
+    workspace.Visit(start);
+    workspace.GValue(start) = 0.f;
+    workspace.Open().Push(start, RouteModel::Distance(nodes[start], nodes[end]));
+    size_t settled = 0;
+    while( !workspace.Open().Empty() ) {
+        int current = workspace.Open().Pop();
+        ++settled;
+        auto targets = graph.Targets(current);
+        auto lengths = graph.Lengths(current);
+        for( size_t i = 0; i < targets.size(); ++i ) {
+            float g_value = workspace.GValue(current) + lengths[i];
+            float key = g_value + RouteModel::Distance(nodes[targets[i]], nodes[end]);
+            if( !workspace.Visited(targets[i]) ) {
+                workspace.Visit(targets[i]);
+                workspace.GValue(targets[i]) = g_value;
+                workspace.Open().Push(targets[i], key);
+            }
+            else if( !workspace.Closed(targets[i]) && g_value < workspace.GValue(targets[i]) ) {
+                workspace.GValue(targets[i]) = g_value;
+                workspace.Open().DecreaseKey(targets[i], key);
+            }
+        }
+    }
+    return settled;
+}
+
+// Queries between the largest component and the others: rejected up front on
+// their component labels, against exhausting the start's component.
+static void BenchComponents(const MappedFile &osm_data)
+{
+    RouteModel model{osm_data.Bytes()};
+    auto &components = model.Components();
+    auto &graph = model.Graph();
+    std::vector<int> largest, others;
+    for( int node = 0; node < graph.NodeCount(); ++node )
+        if( graph.Degree(node) > 0 )
+            (components.Of(node) == 0 ? largest : others).push_back(node);
+    std::cout << "components: " << components.Count() << " components, the largest with "
+              << components.Size(0) << " of " << graph.NodeCount() << " nodes" << std::endl;
+    if( largest.empty() || others.empty() ) {
+        std::cout << "  the road network is connected, nothing to reject" << std::endl;
+        return;
+    }
+
+    // Node positions as percentages of the map, so that they snap to themselves.
+    std::mt19937 rng{7};
+    std::vector<std::pair<int, int>> pairs(256);
+    for( auto &[start, end]: pairs ) {
+        start = largest[std::uniform_int_distribution<size_t>{0, largest.size() - 1}(rng)];
+        end = others[std::uniform_int_distribution<size_t>{0, others.size() - 1}(rng)];
+    }
+    SearchWorkspace workspace;
+    std::vector<std::unique_ptr<RoutePlanner>> planners;
+    size_t found = 0, exhausted = 0;
+    for( auto [start, end]: pairs ) {
+        auto &nodes = model.Nodes();
+        planners.emplace_back(std::make_unique<RoutePlanner>(model, workspace, nodes[start].x * 100.f,
+                                                             nodes[start].y * 100.f, nodes[end].x * 100.f,
+                                                             nodes[end].y * 100.f));
+        planners.back()->AStarSearch();
+        found += !planners.back()->GetPath().empty();
+        exhausted += ExhaustComponent(model, workspace, start, end);
+    }
+
+    auto exhaust_ns = TimePerCall([&]{
+        for( auto [start, end]: pairs )
+            ExhaustComponent(model, workspace, start, end);
+    });
+    auto reject_ns = TimePerCall([&]{
+        for( auto &planner: planners )
+            planner->AStarSearch();
+    });
+    Report("exhausting the component", exhaust_ns, pairs.size(), "query");
+    std::cout << "    settled per query: " << std::setprecision(0) << (double)exhausted / pairs.size() << std::endl;
+    Report("rejected on labels", reject_ns, pairs.size(), "query");
+    std::cout << "  speedup: " << std::setprecision(2) << exhaust_ns / reject_ns
+              << "x, routes found: " << found << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+    std::string osm_data_file = "../map.osm";
+    std::vector<std::string_view> selected;
+    for( int i = 1; i < argc; ++i ) {
+        if( std::string_view{argv[i]} == "-f" && ++i < argc )
+            osm_data_file = argv[i];
+        else
+            selected.emplace_back(argv[i]);
+    }
+
+    auto osm_data = MappedFile::Open(osm_data_file);
+    if( !osm_data ) {
+        std::cout << "Failed to read " << osm_data_file << std::endl;
+        return 1;
+    }
+
+    const std::vector<std::pair<std::string_view, std::function<void(const MappedFile &)>>> benchmarks = {
+        {"parse", BenchParse},
+        {"route", BenchRoute},
+        {"queues", BenchQueues},
+        {"bidirectional", BenchBidirectional},
+        {"landmarks", BenchLandmarks},
+        {"ch", BenchContractionHierarchy},
+        {"snap", BenchSnap},
+        {"components", BenchComponents},
+    };
+    for( auto &[name, run]: benchmarks )
+        if( selected.empty() || std::find(selected.begin(), selected.end(), name) != selected.end() )
+            run(*osm_data);
+    return 0;
+}
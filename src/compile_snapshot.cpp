@@ -0,0 +1,70 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include "mapped_file.h"
+#include "landmarks.h"
+#include "route_model.h"
+
+// Preprocessing step: parses an OSM XML file once and writes the compiled
+// snapshot that OSM_A_star_search can then map in at startup, routing indices
+// included, optionally with ALT landmark tables for its road graph next to it.
+int main(int argc, const char **argv)
+{
+    std::string osm_data_file = "";
+    std::string snapshot_file = "";
+    bool routing_only = false;
+    bool print_stats = false;
+    int landmark_count = 0;
+    for( int i = 1; i < argc; ++i ) {
+        if( std::string_view{argv[i]} == "-f" && ++i < argc )
+            osm_data_file = argv[i];
+        else if( std::string_view{argv[i]} == "-o" && ++i < argc )
+            snapshot_file = argv[i];
+        else if( std::string_view{argv[i]} == "-r" )
+            routing_only = true;
+        else if( std::string_view{argv[i]} == "-l" && ++i < argc )
+            landmark_count = std::atoi(argv[i]);
+        else if( std::string_view{argv[i]} == "--stats" )
+            print_stats = true;
+    }
+    if( osm_data_file.empty() || snapshot_file.empty() ) {
+        std::cout << "Usage: [executable] -f filename.osm -o filename.snapshot [-r] [-l count] [--stats]" << std::endl;
+        std::cout << "  -r       keep only the road network, for headless routing" << std::endl;
+        std::cout << "  -l       also write distance tables for count ALT landmarks to filename.snapshot.landmarks" << std::endl;
+        std::cout << "  --stats  print load timings and memory use as JSON" << std::endl;
+        return 1;
+    }
+
+    auto osm_data = MappedFile::Open(osm_data_file);
+    if( !osm_data ) {
+        std::cout << "Failed to read " << osm_data_file << std::endl;
+        return 1;
+    }
+
+    try {
+        Model::LoadOptions options;
+        options.threads = 0;
+        if( routing_only )
+            options.layers = Model::LoadOptions::Roads;
+        RouteModel model{*osm_data, options};
+        std::ofstream os{snapshot_file, std::ios::binary | std::ios::trunc};
+        model.SaveSnapshot(os);
+        std::cout << "Wrote " << model.Nodes().size() << " nodes and " << model.Ways().size()
+                  << " ways to " << snapshot_file << std::endl;
+        if( landmark_count > 0 ) {
+            Landmarks landmarks{model.Graph(), landmark_count};
+            std::ofstream landmarks_os{snapshot_file + ".landmarks", std::ios::binary | std::ios::trunc};
+            landmarks.Save(landmarks_os);
+            std::cout << "Wrote " << landmarks.Count() << " landmarks to " << snapshot_file << ".landmarks" << std::endl;
+        }
+        if( print_stats )
+            model.Stats().WriteJson(std::cout);
+    }
+    catch( const std::exception &e ) {
+        std::cout << "Failed to compile the snapshot: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,454 @@
+#include "contraction_hierarchy.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// Nodes a witness search may settle before giving up; a missed witness only
+// costs a superfluous shortcut.
+constexpr int kWitnessSettleLimit = 500;
+
+struct Arc {
+    int target;
+    float length;
+    int middle;
+};
+
+struct Shortcut {
+    int from;
+    int to;
+    float length;
+};
+
+// State of one worker thread.
+struct Scratch {
+    SearchWorkspace witness;
+    std::vector<Arc> neighbours;
+};
+
+// Loops shorter than this run on the calling thread alone, where waking the
+// workers would cost more than the loop.
+constexpr size_t kParallelGrain = 64;
+
+// One thread per scratch state, the caller being the first, started once and
+// reused for every loop of a contraction: its rounds are many and short, and
+// starting threads for each would cost more than the work.
+class WorkerPool {
+  public:
+    explicit WorkerPool(std::vector<Scratch> &scratch) : m_Scratch(scratch), m_Errors(scratch.size()) {
+        for (size_t w = 1; w < scratch.size(); ++w)
+            m_Threads.emplace_back([this, w] { this->Work(w); });
+    }
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock{m_Mutex};
+            m_Stop = true;
+        }
+        m_Wake.notify_all();
+        for (auto &thread : m_Threads)
+            thread.join();
+    }
+
+    // Runs f(i, scratch) for i in [0, count) and rethrows the first failure.
+    void Run(size_t count, const std::function<void(size_t, Scratch &)> &f) {
+        if (m_Threads.empty() || count < kParallelGrain) {
+            for (size_t i = 0; i < count; ++i)
+                f(i, m_Scratch[0]);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock{m_Mutex};
+            m_Job = &f;
+            m_Count = count;
+            m_Next = 0;
+            m_Busy = m_Threads.size();
+            ++m_Generation;
+        }
+        m_Wake.notify_all();
+        this->Drain(0);
+        {
+            std::unique_lock<std::mutex> lock{m_Mutex};
+            m_Done.wait(lock, [this] { return m_Busy == 0; });
+            m_Job = nullptr;
+        }
+        for (auto &error : m_Errors)
+            if (error)
+                std::rethrow_exception(std::exchange(error, nullptr));
+    }
+
+  private:
+    void Drain(size_t w) {
+        try {
+            for (size_t i = m_Next++; i < m_Count; i = m_Next++)
+                (*m_Job)(i, m_Scratch[w]);
+        }
+        catch (...) {
+            m_Errors[w] = std::current_exception();
+        }
+    }
+
+    void Work(size_t w) {
+        std::uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock{m_Mutex};
+                m_Wake.wait(lock, [&] { return m_Stop || m_Generation != seen; });
+                if (m_Stop)
+                    return;
+                seen = m_Generation;
+            }
+            this->Drain(w);
+            std::lock_guard<std::mutex> lock{m_Mutex};
+            if (--m_Busy == 0)
+                m_Done.notify_one();
+        }
+    }
+
+    std::vector<Scratch> &m_Scratch;
+    std::vector<std::exception_ptr> m_Errors;
+    std::vector<std::thread> m_Threads;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::condition_variable m_Done;
+    const std::function<void(size_t, Scratch &)> *m_Job = nullptr;
+    size_t m_Count = 0;
+    std::atomic<size_t> m_Next{0};
+    size_t m_Busy = 0;
+    std::uint64_t m_Generation = 0;
+    bool m_Stop = false;
+};
+
+// The graph while it is being contracted: every node's edges and shortcuts,
+// including those to nodes contracted since, which are skipped. The const
+// methods only read it and may run on many threads at once.
+class Contractor {
+  public:
+    explicit Contractor(const RouteGraph &graph) : m_Arcs(graph.NodeCount()), m_Contracted(graph.NodeCount(), 0),
+                                                   m_Deleted(graph.NodeCount(), 0) {
+        for (int node = 0; node < graph.NodeCount(); ++node) {
+            auto targets = graph.Targets(node);
+            auto lengths = graph.Lengths(node);
+            for (size_t i = 0; i < targets.size(); ++i)
+                m_Arcs[node].push_back({targets[i], lengths[i], -1});
+        }
+    }
+
+    int NodeCount() const { return (int)m_Arcs.size(); }
+    const std::vector<Arc> &Arcs(int node) const { return m_Arcs[node]; }
+    bool Contracted(int node) const { return m_Contracted[node]; }
+
+    // Edge difference plus contracted neighbours; lower contracts earlier.
+    float Priority(int node, Scratch &scratch) const {
+        int shortcuts = this->Shortcuts(node, scratch, nullptr);
+        return (float)(shortcuts - (int)scratch.neighbours.size() + m_Deleted[node]);
+    }
+
+    // Counts, and appends to out if given, the shortcuts that contracting node
+    // takes: one for each pair of remaining neighbours with no witness. Leaves
+    // the remaining neighbours in scratch.
+    int Shortcuts(int node, Scratch &scratch, std::vector<Shortcut> *out) const {
+        auto &neighbours = scratch.neighbours;
+        neighbours.clear();
+        for (const Arc &arc : m_Arcs[node])
+            if (!m_Contracted[arc.target] && arc.target != node)
+                neighbours.push_back(arc);
+
+        int shortcuts = 0;
+        for (size_t i = 0; i + 1 < neighbours.size(); ++i) {
+            float limit = 0.0f;
+            for (size_t j = i + 1; j < neighbours.size(); ++j)
+                limit = std::max(limit, neighbours[i].length + neighbours[j].length);
+            this->WitnessSearch(neighbours[i].target, node, limit, scratch.witness);
+
+            for (size_t j = i + 1; j < neighbours.size(); ++j) {
+                int u = neighbours[i].target, w = neighbours[j].target;
+                float via = neighbours[i].length + neighbours[j].length;
+                if (scratch.witness.Visited(w) && scratch.witness.GValue(w) <= via)
+                    continue;
+                ++shortcuts;
+                if (out)
+                    out->push_back({u, w, via});
+            }
+        }
+        return shortcuts;
+    }
+
+    // Takes nodes out of the graph before their shortcuts are searched, so
+    // that nodes contracted together never serve as each other's witnesses.
+    void MarkContracted(int node) { m_Contracted[node] = 1; }
+
+    // Adds the shortcuts found for node and counts it against its neighbours.
+    void Contract(int node, const std::vector<Shortcut> &shortcuts) {
+        for (const Shortcut &shortcut : shortcuts) {
+            this->AddArc(shortcut.from, shortcut.to, shortcut.length, node);
+            this->AddArc(shortcut.to, shortcut.from, shortcut.length, node);
+        }
+        for (const Arc &arc : m_Arcs[node])
+            if (!m_Contracted[arc.target])
+                ++m_Deleted[arc.target];
+    }
+
+  private:
+    // Dijkstra from source over the remaining graph without skip, up to limit.
+    // Reached nodes keep their tentative lengths, which are real path lengths.
+    void WitnessSearch(int source, int skip, float limit, SearchWorkspace &witness) const {
+        witness.Reset(this->NodeCount());
+        witness.Visit(source);
+        witness.GValue(source) = 0.0f;
+        witness.Open().Push(source, 0.0f);
+        for (int settled = 0; !witness.Open().Empty() && settled < kWitnessSettleLimit; ++settled) {
+            int current = witness.Open().Pop();
+            if (witness.GValue(current) > limit)
+                break;
+            for (const Arc &arc : m_Arcs[current]) {
+                if (m_Contracted[arc.target] || arc.target == skip)
+                    continue;
+                float length = witness.GValue(current) + arc.length;
+                if (!witness.Visited(arc.target)) {
+                    witness.Visit(arc.target);
+                    witness.GValue(arc.target) = length;
+                    witness.Open().Push(arc.target, length);
+                }
+                else if (length < witness.GValue(arc.target) && witness.Open().Contains(arc.target)) {
+                    witness.GValue(arc.target) = length;
+                    witness.Open().DecreaseKey(arc.target, length);
+                }
+            }
+        }
+    }
+
+    // Adds the arc from u to w, or shortens an existing one.
+    void AddArc(int u, int w, float length, int middle) {
+        for (Arc &arc : m_Arcs[u])
+            if (arc.target == w) {
+                if (length < arc.length)
+                    arc = {w, length, middle};
+                return;
+            }
+        m_Arcs[u].push_back({w, length, middle});
+    }
+
+    std::vector<std::vector<Arc>> m_Arcs;
+    // Bytes rather than std::vector<bool>, which workers could not read while
+    // another element is written.
+    std::vector<char> m_Contracted;
+    std::vector<int> m_Deleted;
+};
+
+}
+
+ContractionHierarchy::ContractionHierarchy(const RouteGraph &graph, unsigned threads) {
+    Contractor contractor{graph};
+    int node_count = graph.NodeCount();
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<Scratch> scratch(threads);
+    WorkerPool pool{scratch};
+
+    std::vector<int> remaining(node_count);
+    for (int node = 0; node < node_count; ++node)
+        remaining[node] = node;
+    std::vector<float> priority(node_count);
+    pool.Run(remaining.size(), [&](size_t i, Scratch &s) {
+        priority[remaining[i]] = contractor.Priority(remaining[i], s);
+    });
+    // Ties go to the lower node number, so the order is total and every round
+    // contracts at least the node with the smallest priority.
+    auto before = [&](int a, int b) {
+        return priority[a] < priority[b] || (priority[a] == priority[b] && a < b);
+    };
+
+    m_Rank.assign(node_count, -1);
+    int next_rank = 0;
+    std::vector<char> selected(node_count, 0);
+    std::vector<std::vector<Shortcut>> shortcuts;
+    std::vector<int> contracted, touched;
+    while (!remaining.empty()) {
+        // A node whose priority is the smallest within two hops shares no
+        // neighbour with any other such node, so they contract independently.
+        pool.Run(remaining.size(), [&](size_t i, Scratch &) {
+            int node = remaining[i];
+            bool minimum = true;
+            for (const Arc &arc : contractor.Arcs(node)) {
+                if (contractor.Contracted(arc.target) || arc.target == node)
+                    continue;
+                minimum = minimum && before(node, arc.target);
+                for (const Arc &second : contractor.Arcs(arc.target))
+                    if (!contractor.Contracted(second.target) && second.target != node)
+                        minimum = minimum && before(node, second.target);
+                if (!minimum)
+                    break;
+            }
+            selected[node] = minimum;
+        });
+        contracted.clear();
+        for (int node : remaining)
+            if (selected[node]) {
+                contracted.push_back(node);
+                contractor.MarkContracted(node);
+            }
+
+        shortcuts.resize(contracted.size());
+        pool.Run(contracted.size(), [&](size_t i, Scratch &s) {
+            shortcuts[i].clear();
+            contractor.Shortcuts(contracted[i], s, &shortcuts[i]);
+        });
+
+        // Applied in node order, which keeps the hierarchy independent of the
+        // number of threads.
+        touched.clear();
+        for (size_t i = 0; i < contracted.size(); ++i) {
+            int node = contracted[i];
+            m_Rank[node] = next_rank++;
+            contractor.Contract(node, shortcuts[i]);
+            for (const Arc &arc : contractor.Arcs(node))
+                if (!contractor.Contracted(arc.target))
+                    touched.push_back(arc.target);
+        }
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+        pool.Run(touched.size(), [&](size_t i, Scratch &s) {
+            priority[touched[i]] = contractor.Priority(touched[i], s);
+        });
+        remaining.erase(std::remove_if(remaining.begin(), remaining.end(), [&](int node) { return selected[node]; }),
+                        remaining.end());
+    }
+
+    m_Offsets.assign(node_count + 1, 0);
+    for (int node = 0; node < node_count; ++node) {
+        std::vector<Arc> up;
+        for (const Arc &arc : contractor.Arcs(node))
+            if (m_Rank[arc.target] > m_Rank[node])
+                up.push_back(arc);
+        std::sort(up.begin(), up.end(), [](const Arc &a, const Arc &b) { return a.target < b.target; });
+        for (const Arc &arc : up) {
+            m_Targets.push_back(arc.target);
+            m_Lengths.push_back(arc.length);
+            m_Middles.push_back(arc.middle);
+            if (arc.middle >= 0)
+                ++m_ShortcutCount;
+        }
+        m_Offsets[node + 1] = (std::uint32_t)m_Targets.size();
+    }
+}
+
+
+void ContractionHierarchy::Unpack(int a, int b, std::vector<int> &nodes) const {
+    int lower = m_Rank[a] < m_Rank[b] ? a : b;
+    int upper = lower == a ? b : a;
+    auto targets = UpTargets(lower);
+    auto it = std::lower_bound(targets.begin(), targets.end(), upper);
+    int middle = UpMiddles(lower)[it - targets.begin()];
+    if (middle < 0) {
+        nodes.push_back(b);
+        return;
+    }
+    Unpack(a, middle, nodes);
+    Unpack(middle, b, nodes);
+}
+
+
+CHPlanner::CHPlanner(const RouteModel &model, const ContractionHierarchy &hierarchy,
+                     float start_x, float start_y, float end_x, float end_y, SnapScope scope):
+    CHPlanner(model, hierarchy, m_OwnWorkspace, start_x, start_y, end_x, end_y, scope) {}
+
+CHPlanner::CHPlanner(const RouteModel &model, const ContractionHierarchy &hierarchy, SearchWorkspace &workspace,
+                     float start_x, float start_y, float end_x, float end_y, SnapScope scope):
+    m_Model(model), m_Hierarchy(hierarchy), m_Workspace(workspace) {
+    // Inputs are percentages of the map, as for RoutePlanner.
+    this->start_node = m_Model.FindClosestNode(start_x * 0.01f, start_y * 0.01f, scope).Index();
+    this->end_node = m_Model.FindClosestNode(end_x * 0.01f, end_y * 0.01f, scope).Index();
+}
+
+
+void CHPlanner::Search() {
+    this->path.clear();
+    this->distance = 0.0f;
+    this->settled = 0;
+    const GraphComponents &components = m_Model.Components();
+    if (components.Of(start_node) != components.Of(end_node))
+        return;
+
+    SearchWorkspace &forward = m_Workspace;
+    SearchWorkspace &backward = m_Workspace.Reverse();
+    forward.Reset(m_Hierarchy.NodeCount());
+    backward.Reset(m_Hierarchy.NodeCount());
+    for (auto [side, node] : {std::pair{&forward, start_node}, std::pair{&backward, end_node}}) {
+        side->Visit(node);
+        side->GValue(node) = 0.0f;
+        side->Open().Push(node, 0.0f);
+    }
+
+    float best = std::numeric_limits<float>::max();
+    int meet = -1;
+    bool is_forward = false;
+    while (true) {
+        // A side is done once its smallest key cannot lead to a shorter route.
+        auto active = [best](const SearchWorkspace &side) {
+            return !side.Open().Empty() && side.Open().Key(side.Open().Top()) < best;
+        };
+        bool forward_active = active(forward), backward_active = active(backward);
+        if (!forward_active && !backward_active)
+            break;
+        is_forward = forward_active && (!backward_active || !is_forward);
+        SearchWorkspace &side = is_forward ? forward : backward;
+        const SearchWorkspace &other = is_forward ? backward : forward;
+
+        int current = side.Open().Pop();
+        ++this->settled;
+        float g_value = side.GValue(current);
+        if (other.Visited(current) && g_value + other.GValue(current) < best) {
+            best = g_value + other.GValue(current);
+            meet = current;
+        }
+        auto targets = m_Hierarchy.UpTargets(current);
+        auto lengths = m_Hierarchy.UpLengths(current);
+        for (size_t i = 0; i < targets.size(); ++i) {
+            int target = targets[i];
+            float length = g_value + lengths[i];
+            if (!side.Visited(target)) {
+                side.Visit(target);
+                side.Parent(target) = current;
+                side.GValue(target) = length;
+                side.Open().Push(target, length);
+            }
+            else if (length < side.GValue(target) && side.Open().Contains(target)) {
+                side.Parent(target) = current;
+                side.GValue(target) = length;
+                side.Open().DecreaseKey(target, length);
+            }
+        }
+    }
+    if (meet < 0)
+        return;
+
+    // Up from the start to the meeting node, then down to the end, unpacking
+    // every edge and shortcut on the way.
+    std::vector<int> up{meet};
+    for (int node = forward.Parent(meet); node >= 0; node = forward.Parent(node))
+        up.push_back(node);
+    std::reverse(up.begin(), up.end());
+    std::vector<int> nodes{up.front()};
+    for (size_t i = 1; i < up.size(); ++i)
+        m_Hierarchy.Unpack(up[i - 1], up[i], nodes);
+    for (int node = meet; backward.Parent(node) >= 0; node = backward.Parent(node))
+        m_Hierarchy.Unpack(node, backward.Parent(node), nodes);
+
+    auto &model_nodes = m_Model.Nodes();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        this->path.emplace_back(model_nodes[nodes[i]]);
+        if (i > 0)
+            this->distance += RouteModel::Distance(model_nodes[nodes[i - 1]], model_nodes[nodes[i]]);
+    }
+    this->distance *= m_Model.MetricScale();
+}
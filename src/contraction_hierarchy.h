@@ -0,0 +1,95 @@
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include <cstdint>
+#include <vector>
+#include "route_graph.h"
+#include "route_model.h"
+#include "search_workspace.h"
+
+// Contraction Hierarchies over the road graph. Nodes are prioritised by edge
+// difference (shortcuts added minus edges removed) plus the number of already
+// contracted neighbours, and contracted in rounds: each round takes every node
+// whose priority is the smallest within two hops. Those nodes share no
+// neighbours, so their witness searches run in parallel and the result does
+// not depend on the thread count. Contracting a node joins each pair of its
+// remaining neighbours by a shortcut, unless a local witness search finds a
+// path at most as long that avoids it. A node's rank is its place in that
+// order; every edge and shortcut is kept at its lower ranked end, which gives
+// the upward graph the queries search. Shortcuts record the node they bypass,
+// so routes unpack to original edges.
+//
+// The graph is undirected, so one upward graph serves both query directions.
+// The hierarchy is immutable once built and can be shared between threads.
+class ContractionHierarchy {
+  public:
+    ContractionHierarchy() = default;
+    // Contracts on the given number of threads; 0 uses every hardware thread.
+    explicit ContractionHierarchy(const RouteGraph &graph, unsigned threads = 0);
+
+    int NodeCount() const { return (int)m_Rank.size(); }
+    int Rank(int node) const { return m_Rank[node]; }
+    size_t ShortcutCount() const { return m_ShortcutCount; }
+
+    // Edges and shortcuts from node to higher ranked nodes. Middles are the
+    // bypassed node of a shortcut, -1 for an original edge.
+    int UpDegree(int node) const { return (int)(m_Offsets[node + 1] - m_Offsets[node]); }
+    Span<const int> UpTargets(int node) const { return {m_Targets.data() + m_Offsets[node], (size_t)UpDegree(node)}; }
+    Span<const float> UpLengths(int node) const { return {m_Lengths.data() + m_Offsets[node], (size_t)UpDegree(node)}; }
+    Span<const int> UpMiddles(int node) const { return {m_Middles.data() + m_Offsets[node], (size_t)UpDegree(node)}; }
+
+    // Appends the original nodes from a to b, without a, for the edge or
+    // shortcut between them.
+    void Unpack(int a, int b, std::vector<int> &nodes) const;
+
+    size_t Bytes() const {
+        return m_Rank.capacity() * sizeof(int) + m_Offsets.capacity() * sizeof(std::uint32_t) +
+               (m_Targets.capacity() + m_Middles.capacity()) * sizeof(int) + m_Lengths.capacity() * sizeof(float);
+    }
+
+  private:
+    std::vector<int> m_Rank;
+    std::vector<std::uint32_t> m_Offsets{0};
+    std::vector<int> m_Targets;
+    std::vector<float> m_Lengths;
+    std::vector<int> m_Middles;
+    size_t m_ShortcutCount = 0;
+};
+
+
+// One route query on a shared ContractionHierarchy: a bidirectional Dijkstra
+// that only follows upward edges, stopping once neither side can improve on
+// the best meeting node. Takes start and end points like RoutePlanner and
+// returns the same kind of path and distance.
+class CHPlanner {
+  public:
+    using SnapScope = RouteModel::SnapScope;
+
+    CHPlanner(const RouteModel &model, const ContractionHierarchy &hierarchy,
+              float start_x, float start_y, float end_x, float end_y,
+              SnapScope scope = SnapScope::AnyComponent);
+    CHPlanner(const RouteModel &model, const ContractionHierarchy &hierarchy, SearchWorkspace &workspace,
+              float start_x, float start_y, float end_x, float end_y,
+              SnapScope scope = SnapScope::AnyComponent);
+    CHPlanner(const CHPlanner &) = delete;
+    CHPlanner &operator=(const CHPlanner &) = delete;
+
+    float GetDistance() const {return distance;}
+    const std::vector<Model::Node> &GetPath() const {return path;}
+    size_t GetSettledCount() const {return settled;}
+    void Search();
+
+  private:
+    int start_node;
+    int end_node;
+
+    float distance = 0.0f;
+    size_t settled = 0;
+    std::vector<Model::Node> path;
+    const RouteModel &m_Model;
+    const ContractionHierarchy &m_Hierarchy;
+    SearchWorkspace m_OwnWorkspace;
+    SearchWorkspace &m_Workspace;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+// Maps 64-bit OSM ids to the dense numbers the model assigns in load order.
+// Ids are kept in a flat array searched by bisection; OSM extracts list ids in
+// ascending order, in which case the position is the number and no permutation
+// is stored. Otherwise Finalize() builds a sorted permutation, it must be called
+// after the last Add() and before lookups; it is a no-op when nothing changed.
+// Once finalized, Find() is safe to call from several threads. When an id
+// repeats, the element added last wins.
+class IdIndex
+{
+public:
+    void Reserve( std::size_t count ) { m_Ids.reserve(count); }
+    std::size_t Size() const noexcept { return m_Ids.size(); }
+
+    // Registers the next element, its number is the current Size().
+    void Add( std::int64_t id )
+    {
+        if( !m_Ids.empty() && id < m_Ids.back() )
+            m_Ascending = false;
+        m_Ids.emplace_back(id);
+    }
+
+    void Finalize()
+    {
+        if( m_Ascending || m_Order.size() == m_Ids.size() )
+            return;
+        m_Order.resize(m_Ids.size());
+        std::iota(m_Order.begin(), m_Order.end(), 0);
+        std::stable_sort(m_Order.begin(), m_Order.end(), [&](int a, int b){ return m_Ids[a] < m_Ids[b]; });
+    }
+
+    // Returns -1 for unknown ids.
+    int Find( std::int64_t id ) const noexcept
+    {
+        if( m_Ascending ) {
+            auto it = std::upper_bound(m_Ids.begin(), m_Ids.end(), id);
+            if( it == m_Ids.begin() || *(it - 1) != id )
+                return -1;
+            return (int)(it - m_Ids.begin()) - 1;
+        }
+        assert( m_Order.size() == m_Ids.size() );
+        auto it = std::upper_bound(m_Order.begin(), m_Order.end(), id, [&](std::int64_t value, int num){
+            return value < m_Ids[num];
+        });
+        if( it == m_Order.begin() || m_Ids[*(it - 1)] != id )
+            return -1;
+        return *(it - 1);
+    }
+
+private:
+    std::vector<std::int64_t> m_Ids;
+    std::vector<int> m_Order;
+    bool m_Ascending = true;
+};
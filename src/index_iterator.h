@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+// Forward iterator for containers whose operator[] returns by value, such as
+// the struct-of-arrays stores, so that range-for yields those values.
+template <typename Container>
+class IndexIterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = decltype(std::declval<const Container&>()[0]);
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    IndexIterator( const Container *container, std::size_t index ) noexcept: m_Container(container), m_Index(index) {}
+    value_type operator*() const noexcept { return (*m_Container)[m_Index]; }
+    IndexIterator &operator++() noexcept { ++m_Index; return *this; }
+    IndexIterator operator++(int) noexcept { auto it = *this; ++m_Index; return it; }
+    bool operator==( const IndexIterator &other ) const noexcept { return m_Index == other.m_Index; }
+    bool operator!=( const IndexIterator &other ) const noexcept { return m_Index != other.m_Index; }
+
+private:
+    const Container *m_Container;
+    std::size_t m_Index;
+};
@@ -0,0 +1,110 @@
+#ifndef INDEXED_HEAP_H
+#define INDEXED_HEAP_H
+
+#include <algorithm>
+#include <vector>
+
+// Min-priority queue of node numbers in a 4-ary heap. Each queued node's slot
+// in the heap is tracked, so its key can be lowered in place (decrease-key)
+// instead of pushing a duplicate. Keys sit next to node numbers, so sifting
+// never reads outside the heap array, and the four children of an entry share
+// a cache line.
+class IndexedHeap {
+  public:
+    // Empties the queue and makes room for node numbers below node_count. Only
+    // the slots of nodes still queued are touched, unless the size changes.
+    void Reset(int node_count) {
+        if ((size_t)node_count != m_Slot.size()) {
+            m_Slot.assign(node_count, kNotQueued);
+        }
+        else {
+            for (const Entry &entry : m_Entries)
+                m_Slot[entry.node] = kNotQueued;
+        }
+        m_Entries.clear();
+    }
+
+    bool Empty() const { return m_Entries.empty(); }
+    size_t Size() const { return m_Entries.size(); }
+    bool Contains(int node) const { return m_Slot[node] != kNotQueued; }
+    float Key(int node) const { return m_Entries[m_Slot[node]].key; }
+    int Top() const { return m_Entries.front().node; }
+
+    // Queues node, which must not be queued already.
+    void Push(int node, float key) {
+        m_Entries.push_back({key, node});
+        SiftUp(m_Entries.size() - 1);
+    }
+
+    // Lowers the key of a queued node; larger keys are ignored.
+    void DecreaseKey(int node, float key) {
+        size_t slot = m_Slot[node];
+        if (key < m_Entries[slot].key) {
+            m_Entries[slot].key = key;
+            SiftUp(slot);
+        }
+    }
+
+    // Removes and returns the node with the smallest key.
+    int Pop() {
+        int top = m_Entries.front().node;
+        m_Slot[top] = kNotQueued;
+        Entry last = m_Entries.back();
+        m_Entries.pop_back();
+        if (!m_Entries.empty()) {
+            m_Entries.front() = last;
+            SiftDown(0);
+        }
+        return top;
+    }
+
+  private:
+    struct Entry {
+        float key;
+        int node;
+    };
+    static constexpr int kArity = 4;
+    static constexpr int kNotQueued = -1;
+
+    void Place(size_t slot, const Entry &entry) {
+        m_Entries[slot] = entry;
+        m_Slot[entry.node] = (int)slot;
+    }
+
+    void SiftUp(size_t slot) {
+        Entry entry = m_Entries[slot];
+        while (slot > 0) {
+            size_t parent = (slot - 1) / kArity;
+            if (!(entry.key < m_Entries[parent].key))
+                break;
+            Place(slot, m_Entries[parent]);
+            slot = parent;
+        }
+        Place(slot, entry);
+    }
+
+    void SiftDown(size_t slot) {
+        Entry entry = m_Entries[slot];
+        size_t size = m_Entries.size();
+        while (true) {
+            size_t first = slot * kArity + 1;
+            if (first >= size)
+                break;
+            size_t last = std::min(first + kArity, size);
+            size_t best = first;
+            for (size_t child = first + 1; child < last; ++child)
+                if (m_Entries[child].key < m_Entries[best].key)
+                    best = child;
+            if (!(m_Entries[best].key < entry.key))
+                break;
+            Place(slot, m_Entries[best]);
+            slot = best;
+        }
+        Place(slot, entry);
+    }
+
+    std::vector<Entry> m_Entries;
+    std::vector<int> m_Slot;
+};
+
+#endif
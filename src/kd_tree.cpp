@@ -0,0 +1,212 @@
+#include "kd_tree.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include "snapshot_io.h"
+
+namespace {
+
+float Coordinate(const KdTree::Point &point, int axis) { return axis == 0 ? point.x : point.y; }
+
+// Interleaves the bits of two 16-bit values, x in the even bits.
+std::uint32_t Morton(std::uint32_t x, std::uint32_t y) {
+    auto spread = [](std::uint32_t v) {
+        v = (v | (v << 8)) & 0x00FF00FFu;
+        v = (v | (v << 4)) & 0x0F0F0F0Fu;
+        v = (v | (v << 2)) & 0x33333333u;
+        v = (v | (v << 1)) & 0x55555555u;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+}
+
+KdTree::KdTree(std::vector<Point> points) {
+    this->Build(points, 0, points.size(), 0);
+    for (const Point &point : points) {
+        m_X.push_back(point.x);
+        m_Y.push_back(point.y);
+        m_Nodes.push_back(point.node);
+    }
+    this->ComputeBounds();
+}
+
+
+// The arrays are stored in tree order, so nothing needs rebuilding.
+KdTree::KdTree(SnapshotReader &reader, int node_count) {
+    reader.GetArray(m_X);
+    reader.GetArray(m_Y);
+    reader.GetArray(m_Nodes);
+    if (m_X.size() != m_Nodes.size() || m_Y.size() != m_Nodes.size())
+        throw std::logic_error("snapshot is corrupted");
+    CheckSnapshotIndices(m_Nodes, node_count);
+    this->ComputeBounds();
+}
+
+
+void KdTree::Save(SnapshotWriter &writer) const {
+    writer.PutArray(m_X);
+    writer.PutArray(m_Y);
+    writer.PutArray(m_Nodes);
+}
+
+
+void KdTree::ComputeBounds() {
+    if (m_Nodes.empty())
+        return;
+    auto [min_x, max_x] = std::minmax_element(m_X.begin(), m_X.end());
+    auto [min_y, max_y] = std::minmax_element(m_Y.begin(), m_Y.end());
+    m_MinX = *min_x;
+    m_MaxX = *max_x;
+    m_MinY = *min_y;
+    m_MaxY = *max_y;
+}
+
+
+// Puts the median of the range by axis in its middle, smaller ones before it
+// and larger ones after, then does the same for both halves on the other axis,
+// down to leaves.
+void KdTree::Build(std::vector<Point> &points, size_t begin, size_t end, int axis) {
+    if (end - begin <= kLeafSize)
+        return;
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(points.begin() + begin, points.begin() + middle, points.begin() + end,
+                     [axis](const Point &a, const Point &b) { return Coordinate(a, axis) < Coordinate(b, axis); });
+    this->Build(points, begin, middle, 1 - axis);
+    this->Build(points, middle + 1, end, 1 - axis);
+}
+
+
+int KdTree::Nearest(float x, float y) const {
+    Candidate best{std::numeric_limits<float>::max(), -1, 0};
+    this->Search(0, Size(), 0, x, y, nullptr, 0, best);
+    return best.node;
+}
+
+
+int KdTree::Nearest(float x, float y, Span<const int> labels, int label) const {
+    Candidate best{std::numeric_limits<float>::max(), -1, 0};
+    this->Search(0, Size(), 0, x, y, labels.data(), label, best);
+    return best.node;
+}
+
+
+std::vector<int> KdTree::Nearest(float x, float y, size_t k) const {
+    std::vector<Candidate> heap;
+    if (k > 0) {
+        heap.reserve(k);
+        this->Search(0, Size(), 0, x, y, k, heap);
+    }
+    std::sort_heap(heap.begin(), heap.end(), Closer);
+    std::vector<int> nodes;
+    nodes.reserve(heap.size());
+    for (const Candidate &candidate : heap)
+        nodes.push_back(candidate.node);
+    return nodes;
+}
+
+
+void KdTree::Nearest(Span<const float> x, Span<const float> y, Span<int> nodes, Span<float> distances) const {
+    if (y.size() != x.size() || nodes.size() != x.size() || distances.size() != x.size())
+        throw std::invalid_argument("x, y, nodes and distances must have the same size");
+    // Morton codes over the tree's bounds on 16 bits per axis.
+    float scale_x = m_MaxX > m_MinX ? 65535.0f / (m_MaxX - m_MinX) : 0.0f;
+    float scale_y = m_MaxY > m_MinY ? 65535.0f / (m_MaxY - m_MinY) : 0.0f;
+    std::vector<std::uint64_t> order(x.size()), buffer(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        auto column = (std::uint32_t)std::clamp((x[i] - m_MinX) * scale_x, 0.0f, 65535.0f);
+        auto row = (std::uint32_t)std::clamp((y[i] - m_MinY) * scale_y, 0.0f, 65535.0f);
+        order[i] = (std::uint64_t)Morton(column, row) << 32 | i;
+    }
+    // Radix sort on the code, a byte per pass; the index in the low half keeps
+    // the order stable and is not sorted on.
+    for (int shift = 32; shift < 64; shift += 8) {
+        size_t counts[257] = {};
+        for (std::uint64_t entry : order)
+            ++counts[((entry >> shift) & 0xFF) + 1];
+        for (int i = 1; i < 257; ++i)
+            counts[i] += counts[i - 1];
+        for (std::uint64_t entry : order)
+            buffer[counts[(entry >> shift) & 0xFF]++] = entry;
+        order.swap(buffer);
+    }
+
+    // The previous answer is a real point, so its distance bounds the search
+    // without changing which point is found.
+    Candidate previous{std::numeric_limits<float>::max(), -1, 0};
+    for (std::uint64_t entry : order) {
+        size_t i = (std::uint32_t)entry;
+        Candidate best{std::numeric_limits<float>::max(), -1, 0};
+        if (previous.node >= 0) {
+            float dx = m_X[previous.slot] - x[i], dy = m_Y[previous.slot] - y[i];
+            best = {dx * dx + dy * dy, previous.node, previous.slot};
+        }
+        this->Search(0, Size(), 0, x[i], y[i], nullptr, 0, best);
+        nodes[i] = best.node;
+        distances[i] = best.node >= 0 ? std::sqrt(best.distance) : std::numeric_limits<float>::infinity();
+        previous = best;
+    }
+}
+
+
+// Descends into the half holding (x, y) first, and into the other half only if
+// the splitting line is closer than the best point found so far. Distances
+// are squared; ties go to the lower node number. With labels, only points
+// whose node is labelled label count.
+void KdTree::Search(size_t begin, size_t end, int axis, float x, float y, const int *labels, int label,
+                    Candidate &best) const {
+    auto offer = [&](size_t slot) {
+        float dx = m_X[slot] - x, dy = m_Y[slot] - y;
+        Candidate candidate{dx * dx + dy * dy, m_Nodes[slot], slot};
+        if ((!labels || labels[candidate.node] == label) && Closer(candidate, best))
+            best = candidate;
+    };
+    if (end - begin <= kLeafSize) {
+        for (size_t i = begin; i < end; ++i)
+            offer(i);
+        return;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    offer(middle);
+
+    float offset = axis == 0 ? x - m_X[middle] : y - m_Y[middle];
+    bool below = offset < 0.0f;
+    this->Search(below ? begin : middle + 1, below ? middle : end, 1 - axis, x, y, labels, label, best);
+    if (offset * offset <= best.distance)
+        this->Search(below ? middle + 1 : begin, below ? end : middle, 1 - axis, x, y, labels, label, best);
+}
+
+
+// As above, keeping the k best points in a max-heap whose top is the bound.
+void KdTree::Search(size_t begin, size_t end, int axis, float x, float y, size_t k,
+                    std::vector<Candidate> &heap) const {
+    auto offer = [&](size_t slot) {
+        float dx = m_X[slot] - x, dy = m_Y[slot] - y;
+        Candidate candidate{dx * dx + dy * dy, m_Nodes[slot], slot};
+        if (heap.size() < k) {
+            heap.push_back(candidate);
+            std::push_heap(heap.begin(), heap.end(), Closer);
+        }
+        else if (Closer(candidate, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), Closer);
+            heap.back() = candidate;
+            std::push_heap(heap.begin(), heap.end(), Closer);
+        }
+    };
+    if (end - begin <= kLeafSize) {
+        for (size_t i = begin; i < end; ++i)
+            offer(i);
+        return;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    offer(middle);
+
+    float offset = axis == 0 ? x - m_X[middle] : y - m_Y[middle];
+    bool below = offset < 0.0f;
+    this->Search(below ? begin : middle + 1, below ? middle : end, 1 - axis, x, y, k, heap);
+    if (heap.size() < k || offset * offset <= heap.front().distance)
+        this->Search(below ? middle + 1 : begin, below ? end : middle, 1 - axis, x, y, k, heap);
+}
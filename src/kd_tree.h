@@ -0,0 +1,77 @@
+#ifndef KD_TREE_H
+#define KD_TREE_H
+
+#include <cstddef>
+#include <vector>
+#include "span.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Static 2-d tree over points in model coordinates, each carrying a node
+// number. The tree is implicit: the points of a subtree occupy a range of the
+// coordinate arrays with the splitting point at its middle, splitting on x and
+// y by turns, so there are no child pointers. Ranges of up to kLeafSize points
+// are leaves, scanned in full.
+class KdTree {
+  public:
+    struct Point {
+        float x;
+        float y;
+        int node;
+    };
+
+    static constexpr size_t kLeafSize = 8;
+
+    KdTree() = default;
+    explicit KdTree(std::vector<Point> points);
+    // Reads back what Save() wrote for a tree over nodes below node_count.
+    KdTree(SnapshotReader &reader, int node_count);
+    void Save(SnapshotWriter &writer) const;
+
+    size_t Size() const { return m_Nodes.size(); }
+    bool Empty() const { return m_Nodes.empty(); }
+
+    // Node number of the point closest to (x, y), -1 if the tree is empty.
+    int Nearest(float x, float y) const;
+    // Nearest() among the points whose node's entry in labels is label, -1 if there are none.
+    int Nearest(float x, float y, Span<const int> labels, int label) const;
+    // Node numbers of the k points closest to (x, y), nearest first.
+    std::vector<int> Nearest(float x, float y, size_t k) const;
+    // Nearest() for every point of x and y, with the distances to the points
+    // found. Queries run in Morton order, so consecutive ones visit the same
+    // leaves, and each starts out bounded by the point found for the one before.
+    // Throws std::invalid_argument unless all four spans have the same size.
+    void Nearest(Span<const float> x, Span<const float> y, Span<int> nodes, Span<float> distances) const;
+
+    size_t Bytes() const {
+        return (m_X.capacity() + m_Y.capacity()) * sizeof(float) + m_Nodes.capacity() * sizeof(int);
+    }
+
+  private:
+    struct Candidate {
+        float distance;
+        int node;
+        size_t slot;
+    };
+    // Orders by squared distance, ties by node number.
+    static bool Closer(const Candidate &a, const Candidate &b) {
+        return a.distance < b.distance || (a.distance == b.distance && a.node < b.node);
+    }
+
+    void Build(std::vector<Point> &points, size_t begin, size_t end, int axis);
+    void ComputeBounds();
+    void Search(size_t begin, size_t end, int axis, float x, float y, const int *labels, int label,
+                Candidate &best) const;
+    void Search(size_t begin, size_t end, int axis, float x, float y, size_t k, std::vector<Candidate> &heap) const;
+
+    std::vector<float> m_X;
+    std::vector<float> m_Y;
+    std::vector<int> m_Nodes;
+    float m_MinX = 0.0f;
+    float m_MinY = 0.0f;
+    float m_MaxX = 0.0f;
+    float m_MaxY = 0.0f;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "landmarks.h"
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include "indexed_heap.h"
+#include "snapshot_io.h"
+
+namespace {
+
+constexpr char kLandmarksMagic[8] = {'O', 'S', 'M', 'L', 'M', 'R', 'K', '\0'};
+constexpr std::uint32_t kLandmarksVersion = 2;
+
+// Dijkstra from source over the whole graph, infinite for unreachable nodes.
+void ShortestDistances(const RouteGraph &graph, int source, std::vector<float> &dist, IndexedHeap &queue) {
+    dist.assign(graph.NodeCount(), std::numeric_limits<float>::infinity());
+    queue.Reset(graph.NodeCount());
+    dist[source] = 0.0f;
+    queue.Push(source, 0.0f);
+    while (!queue.Empty()) {
+        int node = queue.Pop();
+        auto targets = graph.Targets(node);
+        auto lengths = graph.Lengths(node);
+        for (size_t i = 0; i < targets.size(); ++i) {
+            int target = targets[i];
+            float length = dist[node] + lengths[i];
+            if (!(length < dist[target]))
+                continue;
+            if (queue.Contains(target))
+                queue.DecreaseKey(target, length);
+            else
+                queue.Push(target, length);
+            dist[target] = length;
+        }
+    }
+}
+
+// A node of the largest connected part of the graph, -1 if it has no edges.
+int LargestComponentNode(const RouteGraph &graph) {
+    GraphComponents components{graph};
+    for (int node = 0; node < graph.NodeCount(); ++node)
+        if (components.Of(node) == 0)
+            return graph.Degree(node) > 0 ? node : -1;
+    return -1;
+}
+
+}
+
+Landmarks::Landmarks(const RouteGraph &graph, int count)
+    : m_NodeCount(graph.NodeCount()), m_EdgeCount(graph.EdgeCount()), m_GraphChecksum(graph.Checksum()) {
+    int seed = LargestComponentNode(graph);
+    if (seed < 0 || count <= 0)
+        return;
+
+    IndexedHeap queue;
+    std::vector<float> dist;
+    std::vector<std::vector<float>> tables;
+    // Distance from each node to the nearest landmark chosen so far; the
+    // first landmark is the node farthest from the seed.
+    std::vector<float> nearest;
+    ShortestDistances(graph, seed, nearest, queue);
+    while ((int)m_Landmarks.size() < count) {
+        int farthest = -1;
+        float farthest_distance = 0.0f;
+        for (int node = 0; node < graph.NodeCount(); ++node)
+            if (nearest[node] > farthest_distance && nearest[node] != kUnreachable) {
+                farthest = node;
+                farthest_distance = nearest[node];
+            }
+        if (farthest < 0)
+            break;
+        if (m_Landmarks.empty())
+            std::fill(nearest.begin(), nearest.end(), kUnreachable);
+
+        m_Landmarks.push_back(farthest);
+        ShortestDistances(graph, farthest, dist, queue);
+        for (int node = 0; node < graph.NodeCount(); ++node)
+            nearest[node] = std::min(nearest[node], dist[node]);
+        tables.push_back(dist);
+    }
+
+    m_Distances.resize((size_t)graph.NodeCount() * Count());
+    for (int l = 0; l < Count(); ++l)
+        for (int node = 0; node < graph.NodeCount(); ++node)
+            m_Distances[(size_t)node * Count() + l] = tables[l][node];
+}
+
+
+bool Landmarks::IsLandmarks(Span<const std::byte> data) noexcept {
+    return HasSnapshotMagic(data, kLandmarksMagic);
+}
+
+
+Landmarks::Landmarks(Span<const std::byte> data, const RouteGraph &graph) {
+    SnapshotReader reader = ReadSnapshotFile(data, kLandmarksMagic, kLandmarksVersion);
+    m_NodeCount = reader.Get<std::uint64_t>();
+    m_EdgeCount = reader.Get<std::uint64_t>();
+    m_GraphChecksum = reader.Get<std::uint64_t>();
+    // Same counts are not enough: a map edited in place keeps them, and
+    // distances from another graph would make the bounds inadmissible.
+    if (m_NodeCount != (std::uint64_t)graph.NodeCount() || m_EdgeCount != graph.EdgeCount() ||
+        m_GraphChecksum != graph.Checksum())
+        throw std::logic_error("landmarks were built for a different graph");
+    reader.GetArray(m_Landmarks);
+    reader.GetArray(m_Distances);
+    if (m_Distances.size() != m_NodeCount * m_Landmarks.size())
+        throw std::logic_error("snapshot is corrupted");
+    for (int node : m_Landmarks)
+        if (node < 0 || (std::uint64_t)node >= m_NodeCount)
+            throw std::logic_error("snapshot is corrupted");
+}
+
+
+void Landmarks::Save(std::ostream &os) const {
+    SnapshotWriter writer;
+    writer.Put(m_NodeCount);
+    writer.Put(m_EdgeCount);
+    writer.Put(m_GraphChecksum);
+    writer.PutArray(m_Landmarks);
+    writer.PutArray(m_Distances);
+    WriteSnapshotFile(os, kLandmarksMagic, kLandmarksVersion, writer.Buffer());
+}
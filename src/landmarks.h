@@ -0,0 +1,66 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <vector>
+#include "route_graph.h"
+#include "span.h"
+
+// ALT preprocessing: shortest route lengths from a few landmark nodes to every
+// node. By the triangle inequality |d(l, b) - d(l, a)| never exceeds d(a, b),
+// so the largest such difference over the landmarks is a consistent A*
+// heuristic, and a much tighter one than straight-line distance when a
+// landmark lies behind the target. RouteGraph is undirected, so one table
+// serves as both the forward and the backward one.
+//
+// Landmarks are picked by farthest selection within the largest connected part
+// of the graph: each next landmark is the node farthest from those chosen so
+// far. Nodes outside that part get no bound.
+class Landmarks {
+  public:
+    Landmarks() = default;
+    Landmarks(const RouteGraph &graph, int count);
+    // Loads tables written by Save(), checked against the counts and checksum
+    // of the graph they were built for.
+    Landmarks(Span<const std::byte> data, const RouteGraph &graph);
+
+    static bool IsLandmarks(Span<const std::byte> data) noexcept;
+    void Save(std::ostream &os) const;
+
+    int Count() const { return (int)m_Landmarks.size(); }
+    const std::vector<int> &Nodes() const { return m_Landmarks; }
+    // Route length from the landmark to node in model units, infinite if unreachable.
+    float Distance(int landmark, int node) const { return m_Distances[(size_t)node * Count() + landmark]; }
+
+    // Lower bound on the route length between a and b, 0 if no landmark reaches both.
+    float LowerBound(int a, int b) const {
+        const float *from = &m_Distances[(size_t)a * Count()];
+        const float *to = &m_Distances[(size_t)b * Count()];
+        float bound = 0.0f;
+        for (int l = 0; l < Count(); ++l) {
+            float difference = std::abs(to[l] - from[l]);
+            // Unreachable entries are infinite and give NaN or infinity here.
+            if (difference > bound && difference != kUnreachable)
+                bound = difference;
+        }
+        return bound;
+    }
+
+    size_t Bytes() const { return m_Landmarks.capacity() * sizeof(int) + m_Distances.capacity() * sizeof(float); }
+
+  private:
+    static constexpr float kUnreachable = std::numeric_limits<float>::infinity();
+
+    std::uint64_t m_NodeCount = 0;
+    std::uint64_t m_EdgeCount = 0;
+    std::uint64_t m_GraphChecksum = 0;
+    std::vector<int> m_Landmarks;
+    // Node-major, so the bounds for one node read a single row.
+    std::vector<float> m_Distances;
+};
+
+#endif
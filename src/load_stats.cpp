@@ -0,0 +1,74 @@
+#include "load_stats.h"
+#include <ostream>
+
+double LoadStats::TotalSeconds() const noexcept
+{
+    double total = 0.;
+    for( std::size_t i = 0; i < seconds.size(); ++i )
+        if( i != (std::size_t)Phase::BuildRings )
+            total += seconds[i];
+    return total;
+}
+
+std::size_t LoadStats::TotalBytes() const noexcept
+{
+    std::size_t total = 0;
+    for( auto &u: usage )
+        total += u.bytes;
+    return total;
+}
+
+const char *LoadStats::Name( Phase phase ) noexcept
+{
+    switch( phase ) {
+        case Phase::XmlParse:           return "xml_parse";
+        case Phase::Nodes:              return "nodes";
+        case Phase::Ways:               return "ways";
+        case Phase::Relations:          return "relations";
+        case Phase::BuildRings:         return "build_rings";
+        case Phase::DropUnreferenced:   return "drop_unreferenced";
+        case Phase::AdjustCoordinates:  return "adjust_coordinates";
+        case Phase::SortRoads:          return "sort_roads";
+        case Phase::Snapshot:           return "snapshot";
+        case Phase::NodeToRoad:         return "node_to_road";
+        case Phase::RouteGraph:         return "route_graph";
+        case Phase::Components:         return "components";
+        case Phase::SpatialIndex:       return "spatial_index";
+        case Phase::SegmentIndex:       return "segment_index";
+        case Phase::Count:              break;
+    }
+    return "";
+}
+
+const char *LoadStats::Name( Container container ) noexcept
+{
+    switch( container ) {
+        case Container::Nodes:          return "nodes";
+        case Container::Ways:           return "ways";
+        case Container::Roads:          return "roads";
+        case Container::Railways:       return "railways";
+        case Container::Buildings:      return "buildings";
+        case Container::Leisures:       return "leisures";
+        case Container::Waters:         return "waters";
+        case Container::Landuses:       return "landuses";
+        case Container::NodeToRoad:     return "node_to_road";
+        case Container::RouteGraph:     return "route_graph";
+        case Container::Components:     return "components";
+        case Container::SpatialIndex:   return "spatial_index";
+        case Container::SegmentIndex:   return "segment_index";
+        case Container::Count:          break;
+    }
+    return "";
+}
+
+void LoadStats::WriteJson( std::ostream &os ) const
+{
+    os << "{\n  \"seconds\": {";
+    for( std::size_t i = 0; i < seconds.size(); ++i )
+        os << (i ? ", " : "") << '"' << Name((Phase)i) << "\": " << seconds[i];
+    os << "},\n  \"total_seconds\": " << TotalSeconds() << ",\n  \"containers\": {";
+    for( std::size_t i = 0; i < usage.size(); ++i )
+        os << (i ? "," : "") << "\n    \"" << Name((Container)i) << "\": {\"count\": " << usage[i].count
+           << ", \"bytes\": " << usage[i].bytes << '}';
+    os << "\n  },\n  \"total_bytes\": " << TotalBytes() << "\n}\n";
+}
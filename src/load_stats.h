@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+// Where the time and memory of building a Model (and a RouteModel on top of it)
+// went, filled in during construction. Phases not run by the chosen loader stay
+// at zero. BuildRings runs inside the relation pass and is also counted there.
+struct LoadStats {
+    enum class Phase { XmlParse, Nodes, Ways, Relations, BuildRings, DropUnreferenced,
+                       AdjustCoordinates, SortRoads, Snapshot, NodeToRoad, RouteGraph, Components,
+                       SpatialIndex, SegmentIndex, Count };
+    enum class Container { Nodes, Ways, Roads, Railways, Buildings, Leisures, Waters, Landuses,
+                           NodeToRoad, RouteGraph, Components, SpatialIndex, SegmentIndex, Count };
+
+    // Element count (edges for the route graph) and heap bytes reserved by a container, including the nested
+    // vectors it owns, based on capacities and without allocator overhead.
+    struct Usage {
+        std::size_t count = 0;
+        std::size_t bytes = 0;
+    };
+
+    std::array<double, (std::size_t)Phase::Count> seconds{};
+    std::array<Usage, (std::size_t)Container::Count> usage{};
+
+    double Seconds( Phase phase ) const noexcept { return seconds[(std::size_t)phase]; }
+    const Usage &Memory( Container container ) const noexcept { return usage[(std::size_t)container]; }
+    // Wall time of all phases, BuildRings not counted twice.
+    double TotalSeconds() const noexcept;
+    std::size_t TotalBytes() const noexcept;
+
+    static const char *Name( Phase phase ) noexcept;
+    static const char *Name( Container container ) noexcept;
+
+    // {"seconds": {"xml_parse": ..., ...}, "total_seconds": ...,
+    //  "containers": {"nodes": {"count": ..., "bytes": ...}, ...}, "total_bytes": ...}
+    void WriteJson( std::ostream &os ) const;
+
+    template <typename T>
+    static std::size_t Bytes( const std::vector<T> &v ) noexcept { return v.capacity() * sizeof(T); }
+};
+
+// Charges the wall time since construction or the last Enter() to the current
+// phase, which makes timing loops that move through several phases cheap.
+// Stop() charges the current phase and leaves the timer idle until the next
+// Enter(), for time that belongs to no phase or that another timer counts.
+class PhaseTimer
+{
+public:
+    PhaseTimer( LoadStats &stats, LoadStats::Phase phase ) noexcept:
+        m_Stats(stats), m_Phase(phase), m_Start(Clock::now()) {}
+    PhaseTimer( const PhaseTimer & ) = delete;
+    PhaseTimer &operator=( const PhaseTimer & ) = delete;
+    ~PhaseTimer() { Stop(); }
+
+    void Enter( LoadStats::Phase phase ) noexcept {
+        if( m_Running && phase == m_Phase )
+            return;
+        auto now = Clock::now();
+        Charge(now);
+        m_Phase = phase;
+        m_Start = now;
+        m_Running = true;
+    }
+
+    void Stop() noexcept {
+        Charge(Clock::now());
+        m_Running = false;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void Charge( Clock::time_point now ) noexcept {
+        if( m_Running )
+            m_Stats.seconds[(std::size_t)m_Phase] += std::chrono::duration<double>(now - m_Start).count();
+    }
+
+    LoadStats &m_Stats;
+    LoadStats::Phase m_Phase;
+    Clock::time_point m_Start;
+    bool m_Running = true;
+};
@@ -1,55 +1,57 @@
-#include <optional>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <io2d.h>
+#include <stdexcept>
 #include "route_model.h"
 #include "render.h"
 #include "route_planner.h"
+#include "contraction_hierarchy.h"
+#include "mapped_file.h"
 
 using namespace std::experimental;
 
-static std::optional<std::vector<std::byte>> ReadFile(const std::string &path)
-{   
-    std::ifstream is{path, std::ios::binary | std::ios::ate};
-    if( !is )
-        return std::nullopt;
-    
-    auto size = is.tellg();
-    std::vector<std::byte> contents(size);    
-    
-    is.seekg(0);
-    is.read((char*)contents.data(), size);
-
-    if( contents.empty() )
-        return std::nullopt;
-    return std::move(contents);
-}
-
 int main(int argc, const char **argv)
 {    
     std::string osm_data_file = "";
+    bool print_stats = false;
+    auto search_mode = RoutePlanner::SearchMode::Forward;
+    std::string engine = "astar";
+    auto snap = RoutePlanner::Snap::Node;
+    auto scope = RouteModel::SnapScope::AnyComponent;
     if( argc > 1 ) {
         for( int i = 1; i < argc; ++i )
             if( std::string_view{argv[i]} == "-f" && ++i < argc )
                 osm_data_file = argv[i];
+            else if( std::string_view{argv[i]} == "--stats" )
+                print_stats = true;
+            else if( std::string_view{argv[i]} == "-b" )
+                search_mode = RoutePlanner::SearchMode::Bidirectional;
+            else if( std::string_view{argv[i]} == "-s" )
+                snap = RoutePlanner::Snap::Edge;
+            else if( std::string_view{argv[i]} == "-c" )
+                scope = RouteModel::SnapScope::LargestComponent;
+            else if( std::string_view{argv[i]} == "-e" )
+                engine = ++i < argc ? argv[i] : "";
     }
     else {
         std::cout << "To specify a map file use the following format: " << std::endl;
-        std::cout << "Usage: [executable] [-f filename.osm]" << std::endl;
+        std::cout << "Usage: [executable] [-f filename.osm] [-b] [-s] [-c] [-e astar|ch] [--stats]" << std::endl;
         osm_data_file = "../map.osm";
     }
+    if( engine != "astar" && engine != "ch" ) {
+        std::cout << "Unknown engine '" << engine << "', use -e astar or -e ch" << std::endl;
+        return 1;
+    }
     
-    std::vector<std::byte> osm_data;
- 
-    if( osm_data.empty() && !osm_data_file.empty() ) {
+    MappedFile map_data;
+    if( !osm_data_file.empty() ) {
         std::cout << "Reading OpenStreetMap data from the following file: " <<  osm_data_file << std::endl;
-        auto data = ReadFile(osm_data_file);
-        if( !data )
-            std::cout << "Failed to read." << std::endl;
+        // XML and compiled snapshots are both mapped read-only, Model tells them apart.
+        if( auto mapped = MappedFile::Open(osm_data_file) )
+            map_data = std::move(*mapped);
         else
-            osm_data = std::move(*data);
+            std::cout << "Failed to read." << std::endl;
     }
     
     // UPDATE 1: Declare floats `start_x`, `start_y`, `end_x`, and `end_y` and get
@@ -67,16 +69,42 @@ int main(int argc, const char **argv)
     std::cin >> end_y;
 
     // Build Model.
-    RouteModel model{osm_data};
+    RouteModel model{map_data.Bytes()};
+    if( print_stats )
+        model.Stats().WriteJson(std::cout);
 
-    // Create RoutePlanner object and perform A* search.
-    RoutePlanner route_planner{model, start_x, start_y, end_x, end_y};
-    route_planner.AStarSearch();
+    // ALT landmark tables written by OSM_snapshot -l sit next to the map file.
+    Landmarks landmarks;
+    if( auto landmark_data = MappedFile::Open(osm_data_file + ".landmarks") ) {
+        try {
+            landmarks = Landmarks{landmark_data->Bytes(), model.Graph()};
+        }
+        catch( const std::logic_error &e ) {
+            std::cout << "Ignoring the landmarks: " << e.what() << std::endl;
+        }
+    }
 
-    std::cout << "Distance: " << route_planner.GetDistance() << " meters. \n";
+    // Create RoutePlanner object and perform A* search, or contract the graph
+    // and query the hierarchy when the ch engine is selected.
+    std::vector<Model::Node> path;
+    if( engine == "ch" ) {
+        ContractionHierarchy hierarchy{model.Graph()};
+        CHPlanner ch_planner{model, hierarchy, start_x, start_y, end_x, end_y, scope};
+        ch_planner.Search();
+        std::cout << "Distance: " << ch_planner.GetDistance() << " meters. \n";
+        path = ch_planner.GetPath();
+    }
+    else {
+        RoutePlanner route_planner{model, start_x, start_y, end_x, end_y, snap, scope};
+        if( landmarks.Count() > 0 )
+            route_planner.SetLandmarks(&landmarks);
+        route_planner.AStarSearch(search_mode);
+        std::cout << "Distance: " << route_planner.GetDistance() << " meters. \n";
+        path = route_planner.GetPath();
+    }
 
     // Render results of search.
-    Render render{model};
+    Render render{model, std::move(path)};
 
     auto display = io2d::output_surface{400, 400, io2d::format::argb32, io2d::scaling::none, io2d::refresh_style::fixed, 30};
     display.size_change_callback([](io2d::output_surface& surface){
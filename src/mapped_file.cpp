@@ -0,0 +1,106 @@
+#include "mapped_file.h"
+#include <utility>
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+std::optional<MappedFile> MappedFile::Open( const std::string &path, Access access )
+{
+    auto flags = access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    auto file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    if( file == INVALID_HANDLE_VALUE )
+        return std::nullopt;
+
+    LARGE_INTEGER size;
+    if( !::GetFileSizeEx(file, &size) || size.QuadPart <= 0 ) {
+        ::CloseHandle(file);
+        return std::nullopt;
+    }
+
+    auto mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+    if( !mapping )
+        return std::nullopt;
+    auto addr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    ::CloseHandle(mapping);
+    if( !addr )
+        return std::nullopt;
+
+    MappedFile mapped;
+    mapped.m_Data = static_cast<const std::byte*>(addr);
+    mapped.m_Size = (size_t)size.QuadPart;
+    return mapped;
+}
+
+void MappedFile::Close() noexcept
+{
+    if( m_Data )
+        ::UnmapViewOfFile(m_Data);
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+#else
+
+std::optional<MappedFile> MappedFile::Open( const std::string &path, Access access )
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 )
+        return std::nullopt;
+
+    struct stat st;
+    if( ::fstat(fd, &st) != 0 || st.st_size <= 0 ) {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    auto addr = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if( addr == MAP_FAILED )
+        return std::nullopt;
+    ::madvise(addr, (size_t)st.st_size, access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+    MappedFile mapped;
+    mapped.m_Data = static_cast<const std::byte*>(addr);
+    mapped.m_Size = (size_t)st.st_size;
+    return mapped;
+}
+
+void MappedFile::Close() noexcept
+{
+    if( m_Data )
+        ::munmap(const_cast<std::byte*>(m_Data), m_Size);
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+#endif
+
+MappedFile::MappedFile( MappedFile &&other ) noexcept:
+    m_Data(std::exchange(other.m_Data, nullptr)),
+    m_Size(std::exchange(other.m_Size, 0))
+{
+}
+
+MappedFile &MappedFile::operator=( MappedFile &&other ) noexcept
+{
+    if( this != &other ) {
+        Close();
+        m_Data = std::exchange(other.m_Data, nullptr);
+        m_Size = std::exchange(other.m_Size, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
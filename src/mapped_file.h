@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include "span.h"
+
+// Read-only memory mapping of a whole file, the shared input path for map data.
+// The mapping lives as long as the object, so anything parsed lazily out of it
+// must not outlive the MappedFile. Pages are faulted in on demand, so loading
+// from it never holds a second heap copy of the file.
+class MappedFile
+{
+public:
+    // Sequential lets the kernel read ahead aggressively and drop pages behind
+    // the parser, Random disables read-ahead for scattered lookups.
+    enum class Access { Sequential, Random };
+
+    static std::optional<MappedFile> Open( const std::string &path, Access access = Access::Sequential );
+
+    MappedFile() noexcept = default;
+    MappedFile( MappedFile &&other ) noexcept;
+    MappedFile &operator=( MappedFile &&other ) noexcept;
+    MappedFile( const MappedFile & ) = delete;
+    MappedFile &operator=( const MappedFile & ) = delete;
+    ~MappedFile();
+
+    const std::byte *data() const noexcept { return m_Data; }
+    std::size_t size() const noexcept { return m_Size; }
+    bool empty() const noexcept { return m_Size == 0; }
+    Span<const std::byte> Bytes() const noexcept { return {m_Data, m_Size}; }
+
+private:
+    void Close() noexcept;
+
+    const std::byte *m_Data = nullptr;
+    std::size_t m_Size = 0;
+};
@@ -1,10 +1,17 @@
 #include "model.h"
 #include "pugixml.hpp"
+#include "xml_reader.h"
+#include "id_index.h"
+#include "projection.h"
+#include "osm_parse.h"
 #include <iostream>
 #include <string_view>
 #include <cmath>
 #include <algorithm>
-#include <assert.h>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <unordered_map>
 
 static Model::Road::Type String2RoadType(std::string_view type)
 {
@@ -37,113 +44,222 @@ static Model::Landuse::Type String2LanduseType(std::string_view type)
     return Model::Landuse::Invalid;
 }
 
-Model::Model( const std::vector<std::byte> &xml )
+static std::int64_t ElementId(std::string_view str)
 {
-    LoadData(xml);
+    std::int64_t id;
+    if( !ParseId(str, id) )
+        throw std::logic_error("invalid OSM id \"" + std::string{str} + "\"");
+    return id;
+}
+
+static double Coordinate(std::string_view str)
+{
+    double value;
+    if( !ParseCoordinate(str, value) )
+        throw std::logic_error("invalid coordinate \"" + std::string{str} + "\"");
+    return value;
+}
+
+// Only multipolygon layers are built from relations.
+static constexpr unsigned kRelationLayers =
+    Model::LoadOptions::Buildings | Model::LoadOptions::Waters | Model::LoadOptions::Landuses;
+
+Model::Model( Span<const std::byte> data ):
+    Model(data, LoadOptions{})
+{
+}
+
+Model::Model( Span<const std::byte> data, const LoadOptions &options ):
+    m_Layers(options.layers)
+{
+    using Phase = LoadStats::Phase;
+    if( IsSnapshot(data) ) {
+        PhaseTimer timer{m_Stats, Phase::Snapshot};
+        LoadSnapshot(data);
+    }
+    else {
+        LoadData(data, options);
+        
+        PhaseTimer timer{m_Stats, Phase::DropUnreferenced};
+        if( m_Layers != LoadOptions::All )
+            DropUnreferenced();
+
+        timer.Enter(Phase::AdjustCoordinates);
+        AdjustCoordinates();
+
+        timer.Enter(Phase::SortRoads);
+        std::sort(m_Roads.begin(), m_Roads.end(), [](const auto &_1st, const auto &_2nd){
+            return (int)_1st.type < (int)_2nd.type; 
+        });
+    }
+    MeasureContainers();
+}
+
+void Model::LoadData(Span<const std::byte> xml, const LoadOptions &options)
+{
+    auto threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    if( options.parser == LoadOptions::Parser::DOM )
+        LoadDataDOM(xml);
+    else if( threads > 1 )
+        LoadDataParallel(xml, threads);
+    else
+        LoadDataStreaming(xml);
+}
 
-    AdjustCoordinates();
+void Model::AddWayTag(int way_num, std::string_view category, std::string_view type)
+{
+    if( category == "highway" && HasLayer(LoadOptions::Roads) ) {
+        if( auto road_type = String2RoadType(type); road_type != Road::Invalid ) {
+            m_Roads.emplace_back();
+            m_Roads.back().way = way_num;
+            m_Roads.back().type = road_type;
+        }
+    }
+    if( category == "railway" ) {
+        if( HasLayer(LoadOptions::Railways) ) {
+            m_Railways.emplace_back();
+            m_Railways.back().way = way_num;
+        }
+    }                
+    else if( category == "building" ) {
+        if( HasLayer(LoadOptions::Buildings) ) {
+            m_Buildings.emplace_back();
+            m_Buildings.back().outer = {way_num};
+        }
+    }
+    else if( category == "leisure" ||
+            (category == "natural" && (type == "wood"  || type == "tree_row" || type == "scrub" || type == "grassland")) ||
+            (category == "landcover" && type == "grass" ) ) {
+        if( HasLayer(LoadOptions::Leisures) ) {
+            m_Leisures.emplace_back();
+            m_Leisures.back().outer = {way_num};
+        }
+    }
+    else if( category == "natural" && type == "water" ) {
+        if( HasLayer(LoadOptions::Waters) ) {
+            m_Waters.emplace_back();
+            m_Waters.back().outer = {way_num};
+        }
+    }
+    else if( category == "landuse" ) {
+        if( !HasLayer(LoadOptions::Landuses) )
+            return;
+        if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
+            m_Landuses.emplace_back();
+            m_Landuses.back().outer = {way_num};
+            m_Landuses.back().type = landuse_type;
+        }                    
+    }
+}
 
-    std::sort(m_Roads.begin(), m_Roads.end(), [](const auto &_1st, const auto &_2nd){
-        return (int)_1st.type < (int)_2nd.type; 
-    });
+// Returns true once the relation has been committed, the remaining children are then ignored.
+bool Model::AddRelationTag(std::string_view category, std::string_view type,
+                           std::vector<int> &outer, std::vector<int> &inner)
+{
+    auto commit = [&](Multipolygon &mp) {
+        mp.outer = std::move(outer);
+        mp.inner = std::move(inner);
+    };
+    if( category == "building" ) {
+        if( HasLayer(LoadOptions::Buildings) )
+            commit( m_Buildings.emplace_back() );
+        return true;
+    }
+    if( category == "natural" && type == "water" ) {
+        if( HasLayer(LoadOptions::Waters) ) {
+            commit( m_Waters.emplace_back() );
+            BuildRings(m_Waters.back());
+        }
+        return true;
+    }
+    if( category == "landuse" ) {
+        if( !HasLayer(LoadOptions::Landuses) )
+            return true;
+        if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
+            commit( m_Landuses.emplace_back() );
+            m_Landuses.back().type = landuse_type;
+            BuildRings(m_Landuses.back());
+        }
+        return true;
+    }
+    return false;
 }
 
-void Model::LoadData(const std::vector<std::byte> &xml)
+void Model::LoadDataDOM(Span<const std::byte> xml)
 {
     using namespace pugi;
     
+    PhaseTimer timer{m_Stats, LoadStats::Phase::XmlParse};
     xml_document doc;
     if( !doc.load_buffer(xml.data(), xml.size()) )
         throw std::logic_error("failed to parse the xml file");
     
     if( auto bounds = doc.select_nodes("/osm/bounds"); !bounds.empty() ) {
         auto node = bounds.first().node();
-        m_MinLat = atof(node.attribute("minlat").as_string());
-        m_MaxLat = atof(node.attribute("maxlat").as_string());
-        m_MinLon = atof(node.attribute("minlon").as_string());
-        m_MaxLon = atof(node.attribute("maxlon").as_string());
+        m_MinLat = Coordinate(node.attribute("minlat").as_string());
+        m_MaxLat = Coordinate(node.attribute("maxlat").as_string());
+        m_MinLon = Coordinate(node.attribute("minlon").as_string());
+        m_MaxLon = Coordinate(node.attribute("maxlon").as_string());
     }
     else 
         throw std::logic_error("map's bounds are not defined");
 
-    std::unordered_map<std::string, int> node_id_to_num;
+    timer.Enter(LoadStats::Phase::Nodes);
+    IdIndex node_ids;
     for( const auto &node: doc.select_nodes("/osm/node") ) {
-        node_id_to_num[node.node().attribute("id").as_string()] = (int)m_Nodes.size();
-        m_Nodes.emplace_back();        
-        m_Nodes.back().y = atof(node.node().attribute("lat").as_string());
-        m_Nodes.back().x = atof(node.node().attribute("lon").as_string());
+        node_ids.Add(ElementId(node.node().attribute("id").as_string()));
+        m_LatLon.emplace_back();        
+        m_LatLon.back().y = Coordinate(node.node().attribute("lat").as_string());
+        m_LatLon.back().x = Coordinate(node.node().attribute("lon").as_string());
     }
 
-    std::unordered_map<std::string, int> way_id_to_num;    
+    node_ids.Finalize();
+
+    timer.Enter(LoadStats::Phase::Ways);
+    IdIndex way_ids;
+    std::vector<int> way_nodes;
     for( const auto &way: doc.select_nodes("/osm/way") ) {
         auto node = way.node();
         
         const auto way_num = (int)m_Ways.size();
-        way_id_to_num[node.attribute("id").as_string()] = way_num;
-        m_Ways.emplace_back();
-        auto &new_way = m_Ways.back();
+        way_ids.Add(ElementId(node.attribute("id").as_string()));
+        way_nodes.clear();
         
         for( auto child: node.children() ) {
             auto name = std::string_view{child.name()}; 
             if( name == "nd" ) {
-                auto ref = child.attribute("ref").as_string();
-                if( auto it = node_id_to_num.find(ref); it != end(node_id_to_num) )
-                    new_way.nodes.emplace_back(it->second);
-            }
-            else if( name == "tag" ) {
-                auto category = std::string_view{child.attribute("k").as_string()};
-                auto type = std::string_view{child.attribute("v").as_string()};
-                if( category == "highway" ) {
-                    if( auto road_type = String2RoadType(type); road_type != Road::Invalid ) {
-                        m_Roads.emplace_back();
-                        m_Roads.back().way = way_num;
-                        m_Roads.back().type = road_type;
-                    }
-                }
-                if( category == "railway" ) {
-                    m_Railways.emplace_back();
-                    m_Railways.back().way = way_num;
-                }                
-                else if( category == "building" ) {
-                    m_Buildings.emplace_back();
-                    m_Buildings.back().outer = {way_num};
-                }
-                else if( category == "leisure" ||
-                        (category == "natural" && (type == "wood"  || type == "tree_row" || type == "scrub" || type == "grassland")) ||
-                        (category == "landcover" && type == "grass" ) ) {
-                    m_Leisures.emplace_back();
-                    m_Leisures.back().outer = {way_num};
-                }
-                else if( category == "natural" && type == "water" ) {
-                    m_Waters.emplace_back();
-                    m_Waters.back().outer = {way_num};
-                }
-                else if( category == "landuse" ) {
-                    if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
-                        m_Landuses.emplace_back();
-                        m_Landuses.back().outer = {way_num};
-                        m_Landuses.back().type = landuse_type;
-                    }                    
-                }
+                std::int64_t ref;
+                if( !ParseId(child.attribute("ref").as_string(), ref) )
+                    continue;
+                if( auto node_num = node_ids.Find(ref); node_num >= 0 )
+                    way_nodes.emplace_back(node_num);
             }
         }
+        m_Ways.Add(way_nodes);
+        for( auto child: node.children("tag") ) {
+            auto category = std::string_view{child.attribute("k").as_string()};
+            auto type = std::string_view{child.attribute("v").as_string()};
+            AddWayTag(way_num, category, type);
+        }
     }
+    way_ids.Finalize();
+    if( !HasLayer(kRelationLayers) )
+        return;
     
+    timer.Enter(LoadStats::Phase::Relations);
     for( const auto &relation: doc.select_nodes("/osm/relation") ) {
         auto node = relation.node();
-        auto noode_id = std::string_view{node.attribute("id").as_string()};
         std::vector<int> outer, inner;
-        auto commit = [&](Multipolygon &mp) {
-            mp.outer = std::move(outer);
-            mp.inner = std::move(inner);
-        };
         for( auto child: node.children() ) {
             auto name = std::string_view{child.name()}; 
             if( name == "member" ) {
                 if( std::string_view{child.attribute("type").as_string()} == "way" ) {
-                    if( !way_id_to_num.count(child.attribute("ref").as_string()) )
+                    std::int64_t ref;
+                    if( !ParseId(child.attribute("ref").as_string(), ref) )
+                        continue;
+                    auto way_num = way_ids.Find(ref);
+                    if( way_num < 0 )
                         continue;
-                    auto way_num = way_id_to_num[child.attribute("ref").as_string()];
                     if( std::string_view{child.attribute("role").as_string()} == "outer" )
                         outer.emplace_back(way_num);
                     else
@@ -153,126 +269,528 @@ void Model::LoadData(const std::vector<std::byte> &xml)
             else if( name == "tag" ) { 
                 auto category = std::string_view{child.attribute("k").as_string()};
                 auto type = std::string_view{child.attribute("v").as_string()};
-                if( category == "building" ) {
-                    commit( m_Buildings.emplace_back() );
-                    break;
-                }
-                if( category == "natural" && type == "water" ) {
-                    commit( m_Waters.emplace_back() );
-                    BuildRings(m_Waters.back());
-                    break;
-                }
-                if( category == "landuse" ) {
-                    if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
-                        commit( m_Landuses.emplace_back() );
-                        m_Landuses.back().type = landuse_type;
-                        BuildRings(m_Landuses.back());
-                    }
+                if( AddRelationTag(category, type, outer, inner) )
                     break;
-                }
             }
         }
     }
 }
 
-void Model::AdjustCoordinates()
-{    
-    const auto pi = 3.14159265358979323846264338327950288;
-    const auto deg_to_rad = 2. * pi / 360.;
-    const auto earth_radius = 6378137.;
-    const auto lat2ym = [&](double lat) { return log(tan(lat * deg_to_rad / 2 +  pi/4)) / 2 * earth_radius; };
-    const auto lon2xm = [&](double lon) { return lon * deg_to_rad / 2 * earth_radius; };     
-    const auto dx = lon2xm(m_MaxLon) - lon2xm(m_MinLon);
-    const auto dy = lat2ym(m_MaxLat) - lat2ym(m_MinLat);
-    const auto min_y = lat2ym(m_MinLat);
-    const auto min_x = lon2xm(m_MinLon);
-    m_MetricScale = std::min(dx, dy);
-    for( auto &node: m_Nodes ) {
-        node.x = (lon2xm(node.x) - min_x) / m_MetricScale;
-        node.y = (lat2ym(node.y) - min_y) / m_MetricScale;        
+struct WayTag {
+    std::string_view key;
+    std::string_view value;
+};
+
+// Consumes the element the reader is positioned on, including all of its children.
+static void SkipElement(XmlReader &reader)
+{
+    if( reader.IsEmptyElement() )
+        return;
+    const auto depth = reader.Depth();
+    while( reader.Next() )
+        if( reader.IsEndTag() && reader.Depth() == depth )
+            return;
+}
+
+// Reads the <node> element the reader is positioned on.
+static void ReadNode(XmlReader &reader, std::int64_t &id, Model::Node &node)
+{
+    id = ElementId(reader.Attribute("id"));
+    node.y = Coordinate(reader.Attribute("lat"));
+    node.x = Coordinate(reader.Attribute("lon"));
+    SkipElement(reader);
+}
+
+// Reads the children of the <way> element the reader is positioned on. Tags are
+// only collected, so that workers can run this without touching the model.
+static void ReadWay(XmlReader &reader, const IdIndex &node_ids, std::vector<int> &nodes, std::vector<WayTag> &tags)
+{
+    if( reader.IsEmptyElement() )
+        return;
+    const auto depth = reader.Depth();
+    while( reader.Next() ) {
+        if( reader.IsEndTag() ) {
+            if( reader.Depth() == depth )
+                return;
+            continue;
+        }
+        if( reader.Depth() != depth + 1 )
+            continue;
+        auto name = reader.Name();
+        if( name == "nd" ) {
+            std::int64_t ref;
+            if( !ParseId(reader.Attribute("ref"), ref) )
+                continue;
+            if( auto node_num = node_ids.Find(ref); node_num >= 0 )
+                nodes.emplace_back(node_num);
+        }
+        else if( name == "tag" )
+            tags.push_back({reader.Attribute("k"), reader.Attribute("v")});
     }
 }
 
-static bool TrackRec(const std::vector<int> &open_ways,
-                     const Model::Way *ways,
-                     std::vector<bool> &used,
-                     std::vector<int> &nodes) 
+// Reads the <relation> element the reader is positioned on.
+void Model::ReadRelation(XmlReader &reader, const IdIndex &way_ids)
 {
-    if( nodes.empty() ) {
-        for( int i = 0; i < open_ways.size(); ++i )
-            if( !used[i] ) {
-                used[i] = true;
-                const auto &way_nodes = ways[open_ways[i]].nodes;
-                nodes = way_nodes;
-                if( TrackRec(open_ways, ways, used, nodes) )
-                    return true;
-                nodes.clear();
-                used[i] = false;
+    if( reader.IsEmptyElement() )
+        return;
+    const auto depth = reader.Depth();
+    bool done = false;
+    std::vector<int> outer, inner;
+    while( reader.Next() ) {
+        if( reader.IsEndTag() ) {
+            if( reader.Depth() == depth )
+                return;
+            continue;
+        }
+        if( done || reader.Depth() != depth + 1 )
+            continue;
+        auto name = reader.Name();
+        if( name == "member" ) {
+            if( reader.Attribute("type") == "way" ) {
+                std::int64_t ref;
+                if( !ParseId(reader.Attribute("ref"), ref) )
+                    continue;
+                auto way_num = way_ids.Find(ref);
+                if( way_num < 0 )
+                    continue;
+                if( reader.Attribute("role") == "outer" )
+                    outer.emplace_back(way_num);
+                else
+                    inner.emplace_back(way_num);
             }
-        return false;
+        }
+        else if( name == "tag" )
+            done = AddRelationTag(reader.Attribute("k"), reader.Attribute("v"), outer, inner);
     }
-    else {
-        const auto head = nodes.front();
-        const auto tail = nodes.back();
-        if( head == tail && nodes.size() > 1 )
-            return true;
-        for( int i = 0; i < open_ways.size(); ++i )
-            if( !used[i] ) {
-                const auto &way_nodes = ways[open_ways[i]].nodes;
-                const auto way_head = way_nodes.front();
-                const auto way_tail = way_nodes.back();
-                if( way_head == tail || way_tail == tail ) {
-                    used[i] = true;
-                    const auto len = nodes.size();
-                    if( way_head == tail ) 
-                        nodes.insert(nodes.end(), way_nodes.begin(), way_nodes.end());
-                    else
-                        nodes.insert(nodes.end(), way_nodes.rbegin(), way_nodes.rend());
-                    if( TrackRec(open_ways, ways, used, nodes) )
-                        return true;
-                    nodes.resize(len);                    
-                    used[i] = false;
-                }
+}
+
+void Model::ReadBounds(XmlReader &reader)
+{
+    m_MinLat = Coordinate(reader.Attribute("minlat"));
+    m_MaxLat = Coordinate(reader.Attribute("maxlat"));
+    m_MinLon = Coordinate(reader.Attribute("minlon"));
+    m_MaxLon = Coordinate(reader.Attribute("maxlon"));
+}
+
+// Single pass over the buffer: elements are handled in document order, which for
+// OSM files means all nodes, then all ways, then all relations.
+void Model::LoadDataStreaming(Span<const std::byte> xml)
+{
+    auto begin = reinterpret_cast<const char*>(xml.data());
+    XmlReader reader{begin, begin + xml.size()};
+    
+    bool is_osm = false, has_bounds = false;
+    IdIndex node_ids, way_ids;
+    std::vector<WayTag> tags;
+    std::vector<int> way_nodes;
+    PhaseTimer timer{m_Stats, LoadStats::Phase::XmlParse};
+
+    while( reader.Next() ) {
+        if( reader.Depth() == 0 ) {
+            is_osm = !reader.IsEndTag() && reader.Name() == "osm";
+            continue;
+        }
+        if( !is_osm || reader.Depth() != 1 || reader.IsEndTag() )
+            continue;
+        
+        auto name = reader.Name();
+        if( name == "bounds" && !has_bounds ) {
+            has_bounds = true;
+            ReadBounds(reader);
+        }
+        else if( name == "node" ) {
+            timer.Enter(LoadStats::Phase::Nodes);
+            std::int64_t id;
+            ReadNode(reader, id, m_LatLon.emplace_back());
+            node_ids.Add(id);
+        }
+        else if( name == "way" ) {
+            timer.Enter(LoadStats::Phase::Ways);
+            node_ids.Finalize();
+            way_ids.Add(ElementId(reader.Attribute("id")));
+            tags.clear();
+            way_nodes.clear();
+            ReadWay(reader, node_ids, way_nodes, tags);
+            const auto way_num = m_Ways.Add(way_nodes);
+            for( auto &tag: tags )
+                AddWayTag(way_num, tag.key, tag.value);
+        }
+        else if( name == "relation" ) {
+            timer.Enter(LoadStats::Phase::Relations);
+            way_ids.Finalize();
+            if( HasLayer(kRelationLayers) )
+                ReadRelation(reader, way_ids);
+            else
+                SkipElement(reader);
+        }
+    }
+    
+    if( !has_bounds )
+        throw std::logic_error("map's bounds are not defined");
+}
+
+// Start of the next top-level record with the given element name in [pos, end).
+// '<' cannot appear unescaped in attribute values or text, so outside of comments
+// and CDATA sections, which are ruled out beforehand, every match is a real tag.
+static size_t FindRecord(std::string_view text, std::string_view name, size_t pos, size_t end)
+{
+    while( (pos = text.find('<', pos)) < end ) {
+        auto after = pos + 1 + name.size();
+        if( text.compare(pos + 1, name.size(), name) == 0 && after < text.size() &&
+            (text[after] == ' ' || text[after] == '\t' || text[after] == '\n' || text[after] == '\r' ||
+             text[after] == '/' || text[after] == '>') )
+            return pos;
+        ++pos;
+    }
+    return end;
+}
+
+// Splits [begin, end) into at most `count` ranges that each start on a record.
+static std::vector<std::string_view> SplitRecords(std::string_view text, std::string_view name,
+                                                  size_t begin, size_t end, unsigned count)
+{
+    std::vector<std::string_view> chunks;
+    auto chunk_begin = begin;
+    for( unsigned i = 1; i <= count && chunk_begin < end; ++i ) {
+        auto chunk_end = i == count ? end : FindRecord(text, name, std::max(chunk_begin + 1, begin + (end - begin) / count * i), end);
+        if( chunk_end > chunk_begin )
+            chunks.emplace_back(text.substr(chunk_begin, chunk_end - chunk_begin));
+        chunk_begin = chunk_end;
+    }
+    return chunks;
+}
+
+// Runs f(i) for i in [0, count) on separate threads and rethrows the first failure.
+template <typename F>
+static void ParallelFor(size_t count, F f)
+{
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread> workers;
+    for( size_t i = 0; i < count; ++i )
+        workers.emplace_back([&, i]{
+            try { f(i); }
+            catch( ... ) { errors[i] = std::current_exception(); }
+        });
+    for( auto &worker: workers )
+        worker.join();
+    for( auto &error: errors )
+        if( error )
+            std::rethrow_exception(error);
+}
+
+// Thrown by workers when a section holds records of another type, i.e. the file
+// is not ordered as nodes, ways, relations.
+struct UnorderedInput {};
+
+// Splits the node and way sections at record boundaries and parses the chunks on
+// worker threads into thread-local vectors. Chunks are merged in file order, so
+// node and way numbers are identical to the single-threaded result. Relations
+// are few and mutate m_Ways through BuildRings, so they stay sequential.
+void Model::LoadDataParallel(Span<const std::byte> xml, unsigned threads)
+{
+    PhaseTimer timer{m_Stats, LoadStats::Phase::XmlParse};
+    const auto text = std::string_view{reinterpret_cast<const char*>(xml.data()), xml.size()};
+    const auto end = text.rfind("</osm");
+    const auto nodes_begin = FindRecord(text, "node", 0, end);
+    const auto ways_begin = FindRecord(text, "way", 0, end);
+    const auto relations_begin = FindRecord(text, "relation", 0, end);
+    if( end == std::string_view::npos ||
+        text.find("<!--") != std::string_view::npos || text.find("<![CDATA[") != std::string_view::npos ||
+        nodes_begin > ways_begin || ways_begin > relations_begin ) {
+        timer.Stop();
+        return LoadDataStreaming(xml);
+    }
+
+    const auto header = text.substr(0, nodes_begin);
+    const auto bounds = header.find("<bounds");
+    if( bounds == std::string_view::npos )
+        throw std::logic_error("map's bounds are not defined");
+    XmlReader bounds_reader{header.data() + bounds, header.data() + header.size()};
+    bounds_reader.Next();
+    ReadBounds(bounds_reader);
+    
+    try {
+        timer.Enter(LoadStats::Phase::Nodes);
+        struct NodeChunk {
+            std::vector<std::int64_t> ids;
+            std::vector<Node> nodes;
+        };
+        auto node_chunks = SplitRecords(text, "node", nodes_begin, ways_begin, threads);
+        std::vector<NodeChunk> node_results(node_chunks.size());
+        ParallelFor(node_chunks.size(), [&](size_t i){
+            XmlReader reader{node_chunks[i].data(), node_chunks[i].data() + node_chunks[i].size()};
+            auto &result = node_results[i];
+            while( reader.Next() ) {
+                if( reader.IsEndTag() )
+                    continue;
+                if( reader.Name() != "node" )
+                    throw UnorderedInput{};
+                ReadNode(reader, result.ids.emplace_back(), result.nodes.emplace_back());
+            }
+        });
+        
+        IdIndex node_ids;
+        size_t node_count = 0;
+        for( auto &result: node_results )
+            node_count += result.nodes.size();
+        m_LatLon.reserve(node_count);
+        node_ids.Reserve(node_count);
+        for( auto &result: node_results ) {
+            m_LatLon.insert(m_LatLon.end(), result.nodes.begin(), result.nodes.end());
+            for( auto id: result.ids )
+                node_ids.Add(id);
+        }
+        node_ids.Finalize();
+        node_results = {};
+        
+        timer.Enter(LoadStats::Phase::Ways);
+        struct WayChunk {
+            std::vector<std::int64_t> ids;
+            WayStore ways;
+            std::vector<size_t> tag_offsets{0};
+            std::vector<WayTag> tags;
+        };
+        auto way_chunks = SplitRecords(text, "way", ways_begin, relations_begin, threads);
+        std::vector<WayChunk> way_results(way_chunks.size());
+        ParallelFor(way_chunks.size(), [&](size_t i){
+            XmlReader reader{way_chunks[i].data(), way_chunks[i].data() + way_chunks[i].size()};
+            auto &result = way_results[i];
+            std::vector<int> way_nodes;
+            while( reader.Next() ) {
+                if( reader.IsEndTag() )
+                    continue;
+                if( reader.Name() != "way" )
+                    throw UnorderedInput{};
+                result.ids.emplace_back(ElementId(reader.Attribute("id")));
+                way_nodes.clear();
+                ReadWay(reader, node_ids, way_nodes, result.tags);
+                result.ways.Add(way_nodes);
+                result.tag_offsets.emplace_back(result.tags.size());
+            }
+        });
+        
+        IdIndex way_ids;
+        size_t way_count = 0, way_node_count = 0;
+        for( auto &result: way_results ) {
+            way_count += result.ways.size();
+            way_node_count += result.ways.NodeNumbers().size();
+        }
+        m_Ways.Reserve(way_count, way_node_count);
+        for( auto &result: way_results ) {
+            const auto first_way = (int)m_Ways.size();
+            m_Ways.Append(result.ways);
+            for( size_t i = 0; i < result.ways.size(); ++i ) {
+                const auto way_num = first_way + (int)i;
+                way_ids.Add(result.ids[i]);
+                for( auto t = result.tag_offsets[i]; t < result.tag_offsets[i + 1]; ++t )
+                    AddWayTag(way_num, result.tags[t].key, result.tags[t].value);
             }
-        return false;
+        }
+        way_ids.Finalize();
+        way_results = {};
+        if( !HasLayer(kRelationLayers) )
+            return;
+        
+        timer.Enter(LoadStats::Phase::Relations);
+        XmlReader reader{text.data() + relations_begin, text.data() + end};
+        while( reader.Next() ) {
+            if( reader.IsEndTag() )
+                continue;
+            if( reader.Name() != "relation" )
+                throw UnorderedInput{};
+            ReadRelation(reader, way_ids);
+        }
+    }
+    catch( const UnorderedInput & ) {
+        // The time spent so far stays charged to the phases it was spent in.
+        timer.Stop();
+        m_LatLon.clear();
+        m_Ways.Clear();
+        m_Roads.clear();
+        m_Railways.clear();
+        m_Buildings.clear();
+        m_Leisures.clear();
+        m_Waters.clear();
+        m_Landuses.clear();
+        LoadDataStreaming(xml);
+    }
+}
+
+// Removes the ways no layer refers to, then the nodes no remaining way refers to,
+// and renumbers the references. Relative order is kept on both levels.
+void Model::DropUnreferenced()
+{
+    std::vector<int> way_map(m_Ways.size(), -1);
+    auto mark = [&](const std::vector<int> &ways) { for( auto way: ways ) way_map[way] = 0; };
+    for( auto &road: m_Roads )
+        way_map[road.way] = 0;
+    for( auto &railway: m_Railways )
+        way_map[railway.way] = 0;
+    auto mark_multipolygons = [&](const auto &mps) {
+        for( auto &mp: mps ) {
+            mark(mp.outer);
+            mark(mp.inner);
+        }
+    };
+    mark_multipolygons(m_Buildings);
+    mark_multipolygons(m_Leisures);
+    mark_multipolygons(m_Waters);
+    mark_multipolygons(m_Landuses);
+    
+    std::vector<int> node_map(m_LatLon.size(), -1);
+    WayStore kept;
+    for( size_t i = 0; i < m_Ways.size(); ++i ) {
+        if( way_map[i] < 0 )
+            continue;
+        for( auto node: m_Ways[i].nodes )
+            node_map[node] = 0;
+        way_map[i] = kept.Add(m_Ways[i].nodes);
+    }
+    m_Ways = std::move(kept);
+    
+    int node_count = 0;
+    for( size_t i = 0; i < m_LatLon.size(); ++i )
+        if( node_map[i] >= 0 ) {
+            node_map[i] = node_count;
+            m_LatLon[node_count++] = m_LatLon[i];
+        }
+    m_LatLon.resize(node_count);
+    m_LatLon.shrink_to_fit();
+    m_Ways.ShrinkToFit();
+    
+    for( auto &node: m_Ways.NodeNumbers() )
+        node = node_map[node];
+    auto remap = [&](std::vector<int> &ways) { for( auto &way: ways ) way = way_map[way]; };
+    for( auto &road: m_Roads )
+        road.way = way_map[road.way];
+    for( auto &railway: m_Railways )
+        railway.way = way_map[railway.way];
+    auto remap_multipolygons = [&](auto &mps) {
+        for( auto &mp: mps ) {
+            remap(mp.outer);
+            remap(mp.inner);
+        }
+    };
+    remap_multipolygons(m_Buildings);
+    remap_multipolygons(m_Leisures);
+    remap_multipolygons(m_Waters);
+    remap_multipolygons(m_Landuses);
+}
+
+void Model::MeasureContainers()
+{
+    using Container = LoadStats::Container;
+    auto set = [&](Container container, std::size_t count, std::size_t bytes) {
+        m_Stats.usage[(std::size_t)container] = {count, bytes};
+    };
+    auto multipolygons = [&](Container container, const auto &mps) {
+        auto bytes = LoadStats::Bytes(mps);
+        for( auto &mp: mps )
+            bytes += LoadStats::Bytes(mp.outer) + LoadStats::Bytes(mp.inner);
+        set(container, mps.size(), bytes);
+    };
+    
+    set(Container::Nodes, m_Nodes.size(), m_Nodes.Bytes());
+    set(Container::Ways, m_Ways.size(), m_Ways.Bytes());
+    set(Container::Roads, m_Roads.size(), LoadStats::Bytes(m_Roads));
+    set(Container::Railways, m_Railways.size(), LoadStats::Bytes(m_Railways));
+    multipolygons(Container::Buildings, m_Buildings);
+    multipolygons(Container::Leisures, m_Leisures);
+    multipolygons(Container::Waters, m_Waters);
+    multipolygons(Container::Landuses, m_Landuses);
+}
+
+void Model::AdjustCoordinates()
+{    
+    m_Projection = MercatorProjection::FromBounds(m_MinLat, m_MaxLat, m_MinLon, m_MaxLon);
+    m_MetricScale = m_Projection.scale;
+    
+    // The loaders collect (lon, lat) pairs; the batch kernel and the node store
+    // both want contiguous arrays.
+    std::vector<double> lat(m_LatLon.size()), lon(m_LatLon.size());
+    for( size_t i = 0; i < m_LatLon.size(); ++i ) {
+        lat[i] = m_LatLon[i].y;
+        lon[i] = m_LatLon[i].x;
     }
+    m_Projection.Project(lat.data(), lon.data(), lon.data(), lat.data(), m_LatLon.size());
+    m_Nodes.Assign(lon.data(), lat.data(), m_LatLon.size());
+    m_LatLon.clear();
+    m_LatLon.shrink_to_fit();
 }
 
-static std::vector<int> Track(std::vector<int> &open_ways, const Model::Way *ways)
+// Stitches open ways into closed rings. Way ends are indexed by node, and each
+// ring is grown from the first unused way by appending, at its current tail, the
+// lowest-numbered unused way that starts or ends there. For well-formed relations
+// every junction has exactly one such way, so this visits every way once and
+// yields the rings in the same order and orientation as an exhaustive search.
+// A chain that runs into a dead end is dropped as a whole instead of being
+// backtracked, so broken relations lose the unclosable pieces but never stall.
+static std::vector<std::vector<int>> AssembleRings(const std::vector<int> &open_ways, const WayStore &ways)
 {
-    assert( !open_ways.empty() );
+    std::unordered_map<int, std::vector<int>> ends;
+    ends.reserve(open_ways.size() * 2);
     std::vector<bool> used(open_ways.size(), false);
-    std::vector<int> nodes;    
-    if( TrackRec(open_ways, ways, used, nodes) )
-        for( int i = 0; i < open_ways.size(); ++i )
-            if( used[i] )
-                open_ways[i] = -1;
-    return nodes;
+    for( int i = 0; i < (int)open_ways.size(); ++i ) {
+        const auto nodes = ways[open_ways[i]].nodes;
+        if( nodes.empty() ) {
+            used[i] = true;
+            continue;
+        }
+        ends[nodes.front()].emplace_back(i);
+        if( nodes.back() != nodes.front() )
+            ends[nodes.back()].emplace_back(i);
+    }
+
+    std::vector<std::vector<int>> rings;
+    std::vector<int> ring;
+    for( int start = 0; start < (int)open_ways.size(); ++start ) {
+        if( used[start] )
+            continue;
+        used[start] = true;
+        const auto start_nodes = ways[open_ways[start]].nodes;
+        ring.assign(start_nodes.begin(), start_nodes.end());
+        
+        while( ring.size() < 2 || ring.front() != ring.back() ) {
+            const auto tail = ring.back();
+            int next = -1;
+            for( auto candidate: ends[tail] )
+                if( !used[candidate] ) {
+                    next = candidate;
+                    break;
+                }
+            if( next < 0 )
+                break;
+            used[next] = true;
+            const auto way_nodes = ways[open_ways[next]].nodes;
+            if( way_nodes.front() == tail )
+                ring.insert(ring.end(), way_nodes.begin(), way_nodes.end());
+            else
+                ring.insert(ring.end(), way_nodes.rbegin(), way_nodes.rend());
+        }
+        
+        if( ring.size() > 1 && ring.front() == ring.back() )
+            rings.emplace_back(std::move(ring));
+        ring.clear();
+    }
+    return rings;
 }
 
 void Model::BuildRings( Multipolygon &mp )
 {
+    PhaseTimer timer{m_Stats, LoadStats::Phase::BuildRings};
     auto is_closed = []( const Model::Way &way ) {
         return way.nodes.size() > 1 && way.nodes.front() == way.nodes.back();    
     };
 
     auto process = [&]( std::vector<int> &ways_nums ) {
-        auto ways = m_Ways.data();
         std::vector<int> closed, open;
-        
         for( auto &way_num: ways_nums )
-            (is_closed(ways[way_num]) ? closed : open).emplace_back(way_num);  
+            (is_closed(m_Ways[way_num]) ? closed : open).emplace_back(way_num);  
         
-        while( !open.empty() ) {            
-            auto new_nodes = Track(open, ways);
-            if( new_nodes.empty() )
-                break;
-            open.erase(std::remove_if(open.begin(), open.end(), [](auto v){return v < 0;}), open.end() );
-            closed.emplace_back( (int)m_Ways.size() );
-            Model::Way new_way;
-            new_way.nodes = std::move(new_nodes);
-            m_Ways.emplace_back(new_way);
-        }        
+        if( !open.empty() )
+            for( auto &nodes: AssembleRings(open, m_Ways) )
+                closed.emplace_back( m_Ways.Add(nodes) );
         std::swap(ways_nums, closed);        
     };
 
@@ -1,21 +1,27 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
 #include <string>
+#include <string_view>
 #include <cstddef>
+#include <iosfwd>
+#include "span.h"
+#include "projection.h"
+#include "load_stats.h"
+#include "node_store.h"
+#include "way_store.h"
+
+class XmlReader;
+class IdIndex;
+class SnapshotWriter;
 
 class Model
 {
 public:
-    struct Node {
-        double x = 0.f;
-        double y = 0.f;
-    };
+    using Node = NodePosition;
     
-    struct Way {
-        std::vector<int> nodes;
-    };
+    // A view into the shared way storage, valid as long as the model.
+    using Way = WayView;
     
     struct Road {
         enum Type { Invalid, Unclassified, Service, Residential,
@@ -44,9 +50,37 @@ public:
         Type type;
     };
     
-    Model( const std::vector<std::byte> &xml );
+    struct LoadOptions {
+        // Streaming reads the buffer in a single pass without building a tree,
+        // DOM keeps the original pugixml/XPath loader as a fallback.
+        enum class Parser { Streaming, DOM };
+        Parser parser = Parser::Streaming;
+        // Streaming only: above 1, the node and way sections are parsed on that
+        // many threads; 0 uses every hardware thread.
+        unsigned threads = 1;
+        // Layers to build, as a mask of Layer bits. Ways and nodes that no selected
+        // layer references are dropped, so Roads alone keeps just the road network.
+        enum Layer : unsigned {
+            Roads = 1u << 0, Railways = 1u << 1, Buildings = 1u << 2,
+            Leisures = 1u << 3, Waters = 1u << 4, Landuses = 1u << 5,
+            All = Roads | Railways | Buildings | Leisures | Waters | Landuses
+        };
+        unsigned layers = All;
+    };
+    
+    // Accepts either OSM XML or a compiled snapshot written by SaveSnapshot().
+    Model( Span<const std::byte> data );
+    Model( Span<const std::byte> data, const LoadOptions &options );
+    
+    // Snapshots hold the fully processed model: projected coordinates, sorted roads
+    // and assembled rings, so loading one skips all of the XML work. Derived
+    // models append the indices they build on top, see SaveExtraSections().
+    static bool IsSnapshot( Span<const std::byte> data ) noexcept;
+    void SaveSnapshot( std::ostream &os ) const;
     
     auto MetricScale() const noexcept { return m_MetricScale; }    
+    // Maps latitude/longitude in degrees into the model's coordinate space.
+    auto &Projection() const noexcept { return m_Projection; }
     
     auto &Nodes() const noexcept { return m_Nodes; }
     auto &Ways() const noexcept { return m_Ways; }
@@ -56,14 +90,42 @@ public:
     auto &Waters() const noexcept { return m_Waters; }
     auto &Landuses() const noexcept { return m_Landuses; }
     auto &Railways() const noexcept { return m_Railways; }
+    // Phase timings and container sizes of this model's construction.
+    auto &Stats() const noexcept { return m_Stats; }
+    
+protected:
+    // Appends sections to the snapshot after the model's own. On loading they
+    // are left in m_ExtraSections for the derived model to read back.
+    virtual void SaveExtraSections( SnapshotWriter & ) const {}
+
+    LoadStats m_Stats;
+    // Payload of the snapshot being loaded past the model's own sections, empty
+    // when loading XML. Points into the data given to the constructor, so it is
+    // only valid while constructing.
+    Span<const std::byte> m_ExtraSections;
     
 private:
     void AdjustCoordinates();
     void BuildRings( Multipolygon &mp );
-    void LoadData(const std::vector<std::byte> &xml);
+    void LoadData(Span<const std::byte> xml, const LoadOptions &options);
+    void LoadDataDOM(Span<const std::byte> xml);
+    void LoadDataStreaming(Span<const std::byte> xml);
+    void LoadDataParallel(Span<const std::byte> xml, unsigned threads);
+    void ReadBounds(XmlReader &reader);
+    void ReadRelation(XmlReader &reader, const IdIndex &way_ids);
+    void LoadSnapshot(Span<const std::byte> snapshot);
+    void DropUnreferenced();
+    void MeasureContainers();
+    void AddWayTag(int way_num, std::string_view category, std::string_view type);
+    bool AddRelationTag(std::string_view category, std::string_view type,
+                        std::vector<int> &outer, std::vector<int> &inner);
+    bool HasLayer(unsigned layer) const noexcept { return (m_Layers & layer) != 0; }
     
-    std::vector<Node> m_Nodes;
-    std::vector<Way> m_Ways;
+    NodeStore m_Nodes;
+    // Nodes as read from the file, x = longitude and y = latitude in degrees,
+    // until AdjustCoordinates moves them into m_Nodes.
+    std::vector<Node> m_LatLon;
+    WayStore m_Ways;
     std::vector<Road> m_Roads;
     std::vector<Railway> m_Railways;
     std::vector<Building> m_Buildings;
@@ -76,4 +138,6 @@ private:
     double m_MinLon = 0.;
     double m_MaxLon = 0.;
     double m_MetricScale = 1.f;
+    MercatorProjection m_Projection;
+    unsigned m_Layers = LoadOptions::All;
 };
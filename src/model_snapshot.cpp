@@ -0,0 +1,162 @@
+#include "model.h"
+#include "snapshot_io.h"
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+// Snapshot payload: the model's sections in order, framed as described in
+// snapshot_io.h.
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'O', 'S', 'M', 'S', 'N', 'A', 'P', '\0'};
+constexpr std::uint32_t kSnapshotVersion = 3;
+
+// Node coordinates are stored as encoded, so snapshots only load into builds
+// with the same OSM_COORDINATES precision.
+constexpr std::uint32_t kCoordinateKind = NodeStore::kFixedPoint ? 2 : sizeof(NodeStore::Coordinate) == 4 ? 1 : 0;
+
+template <typename MP>
+void PutMultipolygons(SnapshotWriter &writer, const std::vector<MP> &mps)
+{
+    writer.Put<std::uint64_t>(mps.size());
+    for( auto &mp: mps ) {
+        writer.PutArray(mp.outer);
+        writer.PutArray(mp.inner);
+    }
+}
+
+// Indices and enum values are checked as they are read, so a snapshot that
+// passes its checksum but was written wrongly cannot index out of range later.
+void CheckIndex( std::int64_t index, std::size_t size )
+{
+    if( index < 0 || (std::uint64_t)index >= size )
+        throw std::logic_error("snapshot is corrupted");
+}
+
+template <typename MP>
+void GetMultipolygons(SnapshotReader &reader, std::vector<MP> &mps, std::size_t way_count)
+{
+    mps.resize(reader.Get<std::uint64_t>());
+    for( auto &mp: mps ) {
+        reader.GetArray(mp.outer);
+        reader.GetArray(mp.inner);
+        for( auto way: mp.outer )
+            CheckIndex(way, way_count);
+        for( auto way: mp.inner )
+            CheckIndex(way, way_count);
+    }
+}
+
+}
+
+bool Model::IsSnapshot( Span<const std::byte> data ) noexcept
+{
+    return HasSnapshotMagic(data, kSnapshotMagic);
+}
+
+void Model::SaveSnapshot( std::ostream &os ) const
+{
+    SnapshotWriter writer;
+    writer.Put(m_MinLat);
+    writer.Put(m_MaxLat);
+    writer.Put(m_MinLon);
+    writer.Put(m_MaxLon);
+    writer.Put(m_MetricScale);
+
+    writer.Put<std::uint64_t>(kCoordinateKind);
+    writer.Put(m_Nodes.GetEncoding());
+    writer.PutArray(m_Nodes.EncodedX().data(), m_Nodes.size());
+    writer.PutArray(m_Nodes.EncodedY().data(), m_Nodes.size());
+
+    writer.PutArray(m_Ways.Offsets().data(), m_Ways.Offsets().size());
+    writer.PutArray(m_Ways.NodeNumbers().data(), m_Ways.NodeNumbers().size());
+
+    std::vector<std::int32_t> roads;
+    for( auto &road: m_Roads ) {
+        roads.emplace_back(road.way);
+        roads.emplace_back(road.type);
+    }
+    writer.PutArray(roads);
+
+    std::vector<std::int32_t> railways;
+    for( auto &railway: m_Railways )
+        railways.emplace_back(railway.way);
+    writer.PutArray(railways);
+
+    PutMultipolygons(writer, m_Buildings);
+    PutMultipolygons(writer, m_Leisures);
+    PutMultipolygons(writer, m_Waters);
+    PutMultipolygons(writer, m_Landuses);
+    std::vector<std::int32_t> landuse_types;
+    for( auto &landuse: m_Landuses )
+        landuse_types.emplace_back(landuse.type);
+    writer.PutArray(landuse_types);
+
+    SaveExtraSections(writer);
+    WriteSnapshotFile(os, kSnapshotMagic, kSnapshotVersion, writer.Buffer());
+}
+
+void Model::LoadSnapshot( Span<const std::byte> snapshot )
+{
+    SnapshotReader reader = ReadSnapshotFile(snapshot, kSnapshotMagic, kSnapshotVersion);
+    m_MinLat = reader.Get<double>();
+    m_MaxLat = reader.Get<double>();
+    m_MinLon = reader.Get<double>();
+    m_MaxLon = reader.Get<double>();
+    m_MetricScale = reader.Get<double>();
+    m_Projection = MercatorProjection::FromBounds(m_MinLat, m_MaxLat, m_MinLon, m_MaxLon);
+
+    if( reader.Get<std::uint64_t>() != kCoordinateKind )
+        throw std::logic_error("snapshot was compiled with a different coordinate precision");
+    auto encoding = reader.Get<NodeStore::Encoding>();
+    std::vector<NodeStore::Coordinate> x, y;
+    reader.GetArray(x);
+    reader.GetArray(y);
+    if( x.size() != y.size() )
+        throw std::logic_error("snapshot is corrupted");
+    m_Nodes.AssignEncoded(encoding, std::move(x), std::move(y));
+
+    std::vector<std::uint32_t> way_offsets;
+    std::vector<int> way_nodes;
+    reader.GetArray(way_offsets);
+    reader.GetArray(way_nodes);
+    for( auto node: way_nodes )
+        CheckIndex(node, m_Nodes.size());
+    m_Ways.Assign(std::move(way_offsets), std::move(way_nodes));
+
+    std::vector<std::int32_t> roads;
+    reader.GetArray(roads);
+    if( roads.size() % 2 != 0 )
+        throw std::logic_error("snapshot is corrupted");
+    m_Roads.resize(roads.size() / 2);
+    for( size_t i = 0; i < m_Roads.size(); ++i ) {
+        CheckIndex(roads[i * 2], m_Ways.size());
+        CheckIndex(roads[i * 2 + 1], Road::Footway + 1);
+        m_Roads[i].way = roads[i * 2];
+        m_Roads[i].type = (Road::Type)roads[i * 2 + 1];
+    }
+
+    std::vector<std::int32_t> railways;
+    reader.GetArray(railways);
+    m_Railways.resize(railways.size());
+    for( size_t i = 0; i < m_Railways.size(); ++i ) {
+        CheckIndex(railways[i], m_Ways.size());
+        m_Railways[i].way = railways[i];
+    }
+
+    GetMultipolygons(reader, m_Buildings, m_Ways.size());
+    GetMultipolygons(reader, m_Leisures, m_Ways.size());
+    GetMultipolygons(reader, m_Waters, m_Ways.size());
+    GetMultipolygons(reader, m_Landuses, m_Ways.size());
+    std::vector<std::int32_t> landuse_types;
+    reader.GetArray(landuse_types);
+    if( landuse_types.size() != m_Landuses.size() )
+        throw std::logic_error("snapshot is corrupted");
+    for( size_t i = 0; i < m_Landuses.size(); ++i ) {
+        CheckIndex(landuse_types[i], Landuse::Residential + 1);
+        m_Landuses[i].type = (Landuse::Type)landuse_types[i];
+    }
+
+    m_ExtraSections = reader.Remaining();
+}
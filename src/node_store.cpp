@@ -0,0 +1,51 @@
+#include "node_store.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Picks origin and step so that [min, max] spans the whole unsigned range.
+static void FixedPointAxis( const double *values, std::size_t count, double &origin, double &step )
+{
+    origin = 0.;
+    step = 1.;
+    if( count == 0 )
+        return;
+    auto [min, max] = std::minmax_element(values, values + count);
+    origin = *min;
+    if( *max > *min )
+        step = (*max - *min) / (double)std::numeric_limits<std::uint32_t>::max();
+}
+
+template <typename Coordinate>
+static void Encode( const double *values, std::size_t count, double origin, double step, std::vector<Coordinate> &out )
+{
+    out.resize(count);
+    for( std::size_t i = 0; i < count; ++i ) {
+        if constexpr( std::is_integral_v<Coordinate> ) {
+            auto steps = std::round((values[i] - origin) / step);
+            out[i] = (Coordinate)std::clamp(steps, 0., (double)std::numeric_limits<Coordinate>::max());
+        }
+        else
+            out[i] = (Coordinate)values[i];
+    }
+}
+
+void NodeStore::Assign( const double *x, const double *y, std::size_t count )
+{
+    m_Encoding = {};
+    if constexpr( kFixedPoint ) {
+        FixedPointAxis(x, count, m_Encoding.origin_x, m_Encoding.step_x);
+        FixedPointAxis(y, count, m_Encoding.origin_y, m_Encoding.step_y);
+    }
+    Encode(x, count, m_Encoding.origin_x, m_Encoding.step_x, m_X);
+    Encode(y, count, m_Encoding.origin_y, m_Encoding.step_y, m_Y);
+    m_X.shrink_to_fit();
+    m_Y.shrink_to_fit();
+}
+
+void NodeStore::AssignEncoded( const Encoding &encoding, std::vector<Coordinate> x, std::vector<Coordinate> y )
+{
+    m_Encoding = encoding;
+    m_X = std::move(x);
+    m_Y = std::move(y);
+}
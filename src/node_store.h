@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "span.h"
+#include "index_iterator.h"
+
+// Storage precision of node coordinates, chosen at build time through the
+// OSM_COORDINATES CMake option.
+#if defined(OSM_COORDINATES_FLOAT)
+    using NodeCoordinate = float;
+#elif defined(OSM_COORDINATES_FIXED)
+    using NodeCoordinate = std::uint32_t;
+#else
+    using NodeCoordinate = double;
+#endif
+
+struct NodePosition {
+    double x = 0.f;
+    double y = 0.f;
+};
+
+// Projected node positions as two contiguous coordinate arrays, so that passes
+// over many nodes stream through memory. Fixed-point coordinates are unsigned
+// 32-bit steps from the smallest coordinate on each axis, with the largest one
+// mapped to UINT32_MAX, which resolves well below a millimetre on city maps.
+// Reads always return doubles, whatever the storage precision.
+class NodeStore
+{
+public:
+    using Coordinate = NodeCoordinate;
+    static constexpr bool kFixedPoint = std::is_integral_v<Coordinate>;
+
+    // Maps stored values back to model units: origin + value * step.
+    struct Encoding {
+        double origin_x = 0.;
+        double step_x = 1.;
+        double origin_y = 0.;
+        double step_y = 1.;
+    };
+
+    using const_iterator = IndexIterator<NodeStore>;
+
+    // Replaces the contents with count positions given in model units.
+    void Assign( const double *x, const double *y, std::size_t count );
+    // Replaces the contents with already encoded coordinates, as read from a snapshot.
+    void AssignEncoded( const Encoding &encoding, std::vector<Coordinate> x, std::vector<Coordinate> y );
+
+    std::size_t size() const noexcept { return m_X.size(); }
+    bool empty() const noexcept { return m_X.empty(); }
+    const_iterator begin() const noexcept { return {this, 0}; }
+    const_iterator end() const noexcept { return {this, size()}; }
+
+    double X( std::size_t i ) const noexcept { return Decode(m_X[i], m_Encoding.origin_x, m_Encoding.step_x); }
+    double Y( std::size_t i ) const noexcept { return Decode(m_Y[i], m_Encoding.origin_y, m_Encoding.step_y); }
+    NodePosition operator[]( std::size_t i ) const noexcept { return {X(i), Y(i)}; }
+
+    // Raw stored arrays for batch kernels, decoded with GetEncoding().
+    Span<const Coordinate> EncodedX() const noexcept { return m_X; }
+    Span<const Coordinate> EncodedY() const noexcept { return m_Y; }
+    const Encoding &GetEncoding() const noexcept { return m_Encoding; }
+
+    std::size_t Bytes() const noexcept { return (m_X.capacity() + m_Y.capacity()) * sizeof(Coordinate); }
+
+private:
+    static double Decode( Coordinate value, double origin, double step ) noexcept {
+        if constexpr( kFixedPoint )
+            return origin + (double)value * step;
+        else
+            return (double)value;
+    }
+
+    std::vector<Coordinate> m_X;
+    std::vector<Coordinate> m_Y;
+    Encoding m_Encoding;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+// Allocation-free, locale-independent parsing of OSM attribute values. The
+// functions only look at the given view, so values can be parsed in place
+// without null termination, and report malformed input instead of returning 0.
+
+// OSM ids are 64-bit integers.
+inline bool ParseId( std::string_view str, std::int64_t &id ) noexcept
+{
+    auto end = str.data() + str.size();
+    auto [ptr, ec] = std::from_chars(str.data(), end, id);
+    return ec == std::errc{} && ptr == end;
+}
+
+// Decimal degrees as written by OSM ("-97.7454100"): sign, digits and an
+// optional fraction. Up to 15 significant digits the value is assembled as an
+// exact integer and divided once by an exact power of ten, which yields the
+// correctly rounded double, i.e. the same result as strtod. Longer or
+// exponent-carrying inputs go through std::from_chars.
+inline bool ParseCoordinate( std::string_view str, double &value ) noexcept
+{
+    static constexpr double kPowersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+    };
+
+    auto p = str.data(), end = p + str.size();
+    const bool negative = p != end && *p == '-';
+    if( p != end && (*p == '-' || *p == '+') )
+        ++p;
+
+    std::uint64_t mantissa = 0;
+    int digits = 0, fraction = 0;
+    bool seen_point = false;
+    for( ; p != end; ++p ) {
+        if( *p >= '0' && *p <= '9' ) {
+            mantissa = mantissa * 10 + (std::uint64_t)(*p - '0');
+            ++digits;
+            fraction += seen_point;
+        }
+        else if( *p == '.' && !seen_point )
+            seen_point = true;
+        else
+            break;
+    }
+
+    if( p == end && digits > 0 && digits <= 15 ) {
+        value = (double)mantissa / kPowersOf10[fraction];
+        if( negative )
+            value = -value;
+        return true;
+    }
+
+    auto begin = str.data();
+    if( begin != end && *begin == '+' && ++begin != end && *begin == '-' )
+        return false;
+    auto [ptr, ec] = std::from_chars(begin, end, value);
+    return ec == std::errc{} && ptr == end;
+}
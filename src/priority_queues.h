@@ -0,0 +1,373 @@
+#ifndef PRIORITY_QUEUES_H
+#define PRIORITY_QUEUES_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+// Open list backends for BasicRoutePlanner besides the 4-ary IndexedHeap. All
+// of them queue node numbers below the count given to Reset(), and share its
+// interface: Reset, Empty, Contains, Push, DecreaseKey and Pop.
+//
+// RadixHeap and BucketQueue quantise keys to integers and are monotone: a key
+// below the last popped one is raised to it. A* keys never decrease with a
+// consistent heuristic, so the only cost is that nodes whose keys fall into the
+// same step come out in any order, which can lengthen a route by at most one
+// step per edge.
+
+// Number of bits needed to hold value, 0 for 0: std::bit_width before C++20.
+inline size_t BitWidth(std::uint32_t value) {
+    if (value == 0)
+        return 0;
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return index + 1;
+#elif defined(__GNUC__) || defined(__clang__)
+    return 32 - __builtin_clz(value);
+#else
+    size_t width = 0;
+    for (; value; value >>= 1)
+        ++width;
+    return width;
+#endif
+}
+
+// Which nodes are queued, cleared in O(1) through a generation counter.
+class QueuedNodes {
+  public:
+    void Reset(int node_count) {
+        if ((size_t)node_count != m_Stamp.size() || ++m_Generation == 0) {
+            m_Stamp.assign(node_count, 0);
+            m_Generation = 1;
+        }
+    }
+    bool Contains(int node) const { return m_Stamp[node] == m_Generation; }
+    void Insert(int node) { m_Stamp[node] = m_Generation; }
+    void Erase(int node) { m_Stamp[node] = 0; }
+
+  private:
+    std::uint32_t m_Generation = 0;
+    std::vector<std::uint32_t> m_Stamp;
+};
+
+
+// Pairing heap over per-node link arrays. Decrease-key cuts the node's subtree
+// and melds it with the root; Pop pairs the root's children in two passes.
+class PairingHeap {
+  public:
+    void Reset(int node_count) {
+        m_Queued.Reset(node_count);
+        if ((size_t)node_count != m_Key.size()) {
+            m_Key.resize(node_count);
+            m_Child.resize(node_count);
+            m_Next.resize(node_count);
+            m_Prev.resize(node_count);
+        }
+        m_Root = kNone;
+        m_Size = 0;
+    }
+
+    bool Empty() const { return m_Size == 0; }
+    size_t Size() const { return m_Size; }
+    bool Contains(int node) const { return m_Queued.Contains(node); }
+
+    void Push(int node, float key) {
+        m_Queued.Insert(node);
+        m_Key[node] = key;
+        m_Child[node] = m_Next[node] = m_Prev[node] = kNone;
+        m_Root = m_Root == kNone ? node : Meld(m_Root, node);
+        ++m_Size;
+    }
+
+    void DecreaseKey(int node, float key) {
+        if (!(key < m_Key[node]))
+            return;
+        m_Key[node] = key;
+        if (node == m_Root)
+            return;
+        // Unlink the subtree from its parent or left sibling.
+        int prev = m_Prev[node];
+        if (m_Child[prev] == node)
+            m_Child[prev] = m_Next[node];
+        else
+            m_Next[prev] = m_Next[node];
+        if (m_Next[node] != kNone)
+            m_Prev[m_Next[node]] = prev;
+        m_Next[node] = m_Prev[node] = kNone;
+        m_Root = Meld(m_Root, node);
+    }
+
+    int Pop() {
+        int top = m_Root;
+        m_Queued.Erase(top);
+        --m_Size;
+
+        m_Pairs.clear();
+        for (int child = m_Child[top]; child != kNone;) {
+            int next = m_Next[child];
+            m_Next[child] = m_Prev[child] = kNone;
+            m_Pairs.push_back(child);
+            child = next;
+        }
+        // Meld neighbours left to right, then fold the results right to left.
+        size_t pairs = 0;
+        for (size_t i = 0; i < m_Pairs.size(); i += 2)
+            m_Pairs[pairs++] = i + 1 < m_Pairs.size() ? Meld(m_Pairs[i], m_Pairs[i + 1]) : m_Pairs[i];
+        m_Root = kNone;
+        while (pairs > 0) {
+            int tree = m_Pairs[--pairs];
+            m_Root = m_Root == kNone ? tree : Meld(tree, m_Root);
+        }
+        return top;
+    }
+
+  private:
+    static constexpr int kNone = -1;
+
+    // Links two roots, the larger key becoming the first child of the smaller.
+    int Meld(int a, int b) {
+        if (m_Key[b] < m_Key[a])
+            std::swap(a, b);
+        m_Next[b] = m_Child[a];
+        if (m_Child[a] != kNone)
+            m_Prev[m_Child[a]] = b;
+        m_Prev[b] = a;
+        m_Child[a] = b;
+        return a;
+    }
+
+    QueuedNodes m_Queued;
+    std::vector<float> m_Key;
+    std::vector<int> m_Child;
+    std::vector<int> m_Next;
+    // Left sibling, or parent for a first child.
+    std::vector<int> m_Prev;
+    std::vector<int> m_Pairs;
+    int m_Root = kNone;
+    size_t m_Size = 0;
+};
+
+
+// Monotone radix heap over keys quantised to 32-bit integers. Bucket i > 0
+// holds keys whose highest bit differing from the last popped key is bit i - 1,
+// so every entry moves down at most 32 times. Decrease-key pushes a new entry
+// and leaves the old one to be skipped.
+class RadixHeap {
+  public:
+    // Key steps per model unit; model coordinates span about one unit.
+    static constexpr float kScale = 1 << 20;
+
+    void Reset(int node_count) {
+        m_Queued.Reset(node_count);
+        m_Key.resize(node_count);
+        for (auto &bucket : m_Buckets)
+            bucket.clear();
+        m_Last = 0;
+        m_Size = 0;
+    }
+
+    bool Empty() const { return m_Size == 0; }
+    size_t Size() const { return m_Size; }
+    bool Contains(int node) const { return m_Queued.Contains(node); }
+
+    void Push(int node, float key) {
+        m_Queued.Insert(node);
+        Insert(node, Quantize(key));
+        ++m_Size;
+    }
+
+    void DecreaseKey(int node, float key) {
+        std::uint32_t quantised = Quantize(key);
+        if (quantised < m_Key[node])
+            Insert(node, quantised);
+    }
+
+    int Pop() {
+        while (true) {
+            if (m_Buckets[0].empty())
+                Refill();
+            Entry entry = m_Buckets[0].back();
+            m_Buckets[0].pop_back();
+            if (Live(entry)) {
+                m_Queued.Erase(entry.node);
+                --m_Size;
+                return entry.node;
+            }
+        }
+    }
+
+  private:
+    struct Entry {
+        std::uint32_t key;
+        int node;
+    };
+
+    std::uint32_t Quantize(float key) const {
+        double steps = std::floor((double)key * kScale);
+        if (steps >= (double)std::numeric_limits<std::uint32_t>::max())
+            return std::numeric_limits<std::uint32_t>::max();
+        return std::max(m_Last, (std::uint32_t)std::max(steps, 0.0));
+    }
+
+    size_t Bucket(std::uint32_t key) const {
+        return BitWidth(key ^ m_Last);
+    }
+
+    void Insert(int node, std::uint32_t key) {
+        m_Key[node] = key;
+        m_Buckets[Bucket(key)].push_back({key, node});
+    }
+
+    bool Live(const Entry &entry) const { return m_Queued.Contains(entry.node) && m_Key[entry.node] == entry.key; }
+
+    // Moves the smallest key into bucket 0 by redistributing the first
+    // non-empty bucket around it.
+    void Refill() {
+        for (size_t i = 1; i < m_Buckets.size(); ++i) {
+            auto &bucket = m_Buckets[i];
+            std::uint32_t smallest = std::numeric_limits<std::uint32_t>::max();
+            bool live = false;
+            for (const Entry &entry : bucket)
+                if (Live(entry)) {
+                    smallest = std::min(smallest, entry.key);
+                    live = true;
+                }
+            if (!live) {
+                bucket.clear();
+                continue;
+            }
+            m_Last = smallest;
+            m_Spill.swap(bucket);
+            for (const Entry &entry : m_Spill)
+                if (Live(entry))
+                    m_Buckets[Bucket(entry.key)].push_back(entry);
+            m_Spill.clear();
+            return;
+        }
+    }
+
+    QueuedNodes m_Queued;
+    std::vector<std::uint32_t> m_Key;
+    std::array<std::vector<Entry>, 33> m_Buckets;
+    std::vector<Entry> m_Spill;
+    std::uint32_t m_Last = 0;
+    size_t m_Size = 0;
+};
+
+
+// Dial's bucket queue over keys quantised to coarse integer steps: a ring of
+// buckets, one per step, scanned upwards from the last popped key. The ring
+// grows when a key lands beyond it, which stays rare as the span of open keys
+// is bounded by twice the longest edge. Decrease-key pushes a new entry and
+// leaves the old one to be skipped.
+class BucketQueue {
+  public:
+    // Key steps per model unit, a few centimetres on a city map.
+    static constexpr float kScale = 1 << 14;
+
+    void Reset(int node_count) {
+        m_Queued.Reset(node_count);
+        m_Key.resize(node_count);
+        // Buckets behind the cursor are drained, so entries only remain
+        // between it and the highest key.
+        if (m_Ring.empty())
+            m_Ring.resize(1024);
+        else if (m_Highest - m_Cursor >= m_Ring.size())
+            for (auto &bucket : m_Ring)
+                bucket.clear();
+        else
+            for (std::uint32_t key = m_Cursor; key != m_Highest + 1; ++key)
+                m_Ring[key & (m_Ring.size() - 1)].clear();
+        m_Cursor = 0;
+        m_Highest = 0;
+        m_Popped = false;
+        m_Size = 0;
+    }
+
+    bool Empty() const { return m_Size == 0; }
+    size_t Size() const { return m_Size; }
+    bool Contains(int node) const { return m_Queued.Contains(node); }
+
+    void Push(int node, float key) {
+        m_Queued.Insert(node);
+        Insert(node, Quantize(key));
+        ++m_Size;
+    }
+
+    void DecreaseKey(int node, float key) {
+        std::uint32_t quantised = Quantize(key);
+        if (quantised < m_Key[node])
+            Insert(node, quantised);
+    }
+
+    int Pop() {
+        while (true) {
+            auto &bucket = m_Ring[m_Cursor & (m_Ring.size() - 1)];
+            while (!bucket.empty()) {
+                int node = bucket.back();
+                bucket.pop_back();
+                if (m_Queued.Contains(node) && m_Key[node] == m_Cursor) {
+                    m_Popped = true;
+                    m_Queued.Erase(node);
+                    --m_Size;
+                    return node;
+                }
+            }
+            ++m_Cursor;
+        }
+    }
+
+  private:
+    std::uint32_t Quantize(float key) const {
+        double steps = std::floor((double)key * kScale);
+        if (steps >= (double)std::numeric_limits<std::uint32_t>::max())
+            return std::numeric_limits<std::uint32_t>::max();
+        return (std::uint32_t)std::max(steps, 0.0);
+    }
+
+    // Until the first pop the cursor follows the smallest key, so the scan
+    // starts there rather than at zero; afterwards keys are raised to it.
+    void Insert(int node, std::uint32_t key) {
+        if (m_Popped)
+            key = std::max(key, m_Cursor);
+        else if (m_Size == 0 || key < m_Cursor)
+            m_Cursor = key;
+        m_Highest = m_Size == 0 ? key : std::max(m_Highest, key);
+        if (m_Highest - m_Cursor >= m_Ring.size())
+            Grow(m_Highest - m_Cursor + 1);
+        m_Key[node] = key;
+        m_Ring[key & (m_Ring.size() - 1)].push_back(node);
+    }
+
+    // Re-buckets the live entries into a ring of at least span buckets.
+    void Grow(size_t span) {
+        size_t size = m_Ring.size();
+        while (size < span)
+            size *= 2;
+        std::vector<std::vector<int>> ring(size);
+        for (size_t i = 0; i < m_Ring.size(); ++i)
+            for (int node : m_Ring[i])
+                if (m_Queued.Contains(node) && (m_Key[node] & (m_Ring.size() - 1)) == i)
+                    ring[m_Key[node] & (size - 1)].push_back(node);
+        m_Ring.swap(ring);
+    }
+
+    QueuedNodes m_Queued;
+    std::vector<std::uint32_t> m_Key;
+    // Power-of-two sized, indexed by key modulo its size.
+    std::vector<std::vector<int>> m_Ring;
+    std::uint32_t m_Cursor = 0;
+    // Largest key inserted since the queue was last empty.
+    std::uint32_t m_Highest = 0;
+    bool m_Popped = false;
+    size_t m_Size = 0;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#include "projection.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#if OSM_SIMD_X86
+    #include <immintrin.h>
+#endif
+
+// The batch kernels avoid libm: log(tan(pi/4 + lat/2)) is rewritten as
+// ln((1 + sin lat) / (1 - sin lat)) / 2, with sin evaluated by its Taylor series
+// (|lat| <= 85 degrees, truncation error below 1e-18) and ln split into exponent
+// and mantissa, the latter through the atanh series on [sqrt(1/2), sqrt(2)).
+// Every kernel performs the same operations in the same order, and all of them
+// stay within a few ulp of the std::log/std::tan reference.
+namespace {
+
+constexpr double kPi = 3.14159265358979323846264338327950288;
+constexpr double kDegToRad = 2. * kPi / 360.;
+constexpr double kEarthRadius = 6378137.;
+constexpr double kSqrt2 = 1.41421356237309504880;
+constexpr double kLn2Hi = 6.93147180369123816490e-01;
+constexpr double kLn2Lo = 1.90821492927058770002e-10;
+
+// sin(x) = x + x^3 * (S[0] + x^2 * (S[1] + ...)), Horner order from the highest term.
+constexpr double kSin[] = {
+    1. / 51090942171709440000., -1. / 121645100408832000., 1. / 355687428096000.,
+    -1. / 1307674368000., 1. / 6227020800., -1. / 39916800., 1. / 362880.,
+    -1. / 5040., 1. / 120., -1. / 6.
+};
+
+// ln(m) = 2t + 2t^3 * (L[0] + t^2 * (L[1] + ...)), t = (m - 1) / (m + 1).
+constexpr double kLog[] = {
+    1. / 19., 1. / 17., 1. / 15., 1. / 13., 1. / 11., 1. / 9., 1. / 7., 1. / 5., 1. / 3.
+};
+
+constexpr std::uint64_t kMantissaMask = 0x000FFFFFFFFFFFFFull;
+constexpr std::uint64_t kExponentOne = 0x3FF0000000000000ull;
+constexpr std::uint64_t kTwo52Bits = 0x4330000000000000ull;
+constexpr double kTwo52 = 4503599627370496.;
+constexpr double kExponentBias = 1023.;
+
+inline double ProjectLatScalar(double lat)
+{
+    const double a = lat * kDegToRad;
+    const double a2 = a * a;
+    double p = kSin[0];
+    for( size_t i = 1; i < std::size(kSin); ++i )
+        p = p * a2 + kSin[i];
+    const double s = a + a * a2 * p;
+    const double r = (1. + s) / (1. - s);
+
+    std::uint64_t bits;
+    memcpy(&bits, &r, sizeof(bits));
+    std::uint64_t m_bits = (bits & kMantissaMask) | kExponentOne;
+    std::uint64_t e_bits = (bits >> 52) | kTwo52Bits;
+    double m, e;
+    memcpy(&m, &m_bits, sizeof(m));
+    memcpy(&e, &e_bits, sizeof(e));
+    e = e - kTwo52 - kExponentBias;
+    if( m > kSqrt2 ) {
+        m = m * 0.5;
+        e = e + 1.;
+    }
+
+    const double t = (m - 1.) / (m + 1.);
+    const double t2 = t * t;
+    double q = kLog[0];
+    for( size_t i = 1; i < std::size(kLog); ++i )
+        q = q * t2 + kLog[i];
+    const double ln_m = 2. * t + 2. * t * t2 * q;
+    const double ln_r = e * kLn2Hi + (e * kLn2Lo + ln_m);
+    return 0.5 * ln_r / 2. * kEarthRadius;
+}
+
+inline double ProjectLonScalar(double lon)
+{
+    return lon * kDegToRad / 2. * kEarthRadius;
+}
+
+void ProjectScalar(const MercatorProjection &p, const double *lat, const double *lon, double *x, double *y,
+                   size_t begin, size_t count)
+{
+    for( size_t i = begin; i < count; ++i ) {
+        const double xm = ProjectLonScalar(lon[i]);
+        const double ym = ProjectLatScalar(lat[i]);
+        x[i] = (xm - p.origin_x) / p.scale;
+        y[i] = (ym - p.origin_y) / p.scale;
+    }
+}
+
+#if OSM_SIMD_X86
+
+OSM_TARGET_SSE2
+size_t ProjectSSE2(const MercatorProjection &p, const double *lat, const double *lon, double *x, double *y,
+                   size_t count)
+{
+    const __m128d deg_to_rad = _mm_set1_pd(kDegToRad);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d one = _mm_set1_pd(1.);
+    const __m128d two = _mm_set1_pd(2.);
+    const __m128d earth_radius = _mm_set1_pd(kEarthRadius);
+    const __m128d origin_x = _mm_set1_pd(p.origin_x);
+    const __m128d origin_y = _mm_set1_pd(p.origin_y);
+    const __m128d scale = _mm_set1_pd(p.scale);
+    const __m128i mantissa_mask = _mm_set1_epi64x((long long)kMantissaMask);
+    const __m128i exponent_one = _mm_set1_epi64x((long long)kExponentOne);
+    const __m128i two52_bits = _mm_set1_epi64x((long long)kTwo52Bits);
+    const __m128d exponent_offset = _mm_set1_pd(kTwo52 + kExponentBias);
+
+    size_t i = 0;
+    for( ; i + 2 <= count; i += 2 ) {
+        const __m128d vlon = _mm_loadu_pd(lon + i);
+        const __m128d vlat = _mm_loadu_pd(lat + i);
+        const __m128d xm = _mm_mul_pd(_mm_div_pd(_mm_mul_pd(vlon, deg_to_rad), two), earth_radius);
+
+        const __m128d a = _mm_mul_pd(vlat, deg_to_rad);
+        const __m128d a2 = _mm_mul_pd(a, a);
+        __m128d sp = _mm_set1_pd(kSin[0]);
+        for( size_t k = 1; k < std::size(kSin); ++k )
+            sp = _mm_add_pd(_mm_mul_pd(sp, a2), _mm_set1_pd(kSin[k]));
+        const __m128d s = _mm_add_pd(a, _mm_mul_pd(_mm_mul_pd(a, a2), sp));
+        const __m128d r = _mm_div_pd(_mm_add_pd(one, s), _mm_sub_pd(one, s));
+
+        const __m128i bits = _mm_castpd_si128(r);
+        __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, mantissa_mask), exponent_one));
+        __m128d e = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), two52_bits));
+        e = _mm_sub_pd(e, exponent_offset);
+        const __m128d big = _mm_cmpgt_pd(m, _mm_set1_pd(kSqrt2));
+        m = _mm_or_pd(_mm_and_pd(big, _mm_mul_pd(m, half)), _mm_andnot_pd(big, m));
+        e = _mm_add_pd(e, _mm_and_pd(big, one));
+
+        const __m128d t = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+        const __m128d t2 = _mm_mul_pd(t, t);
+        __m128d q = _mm_set1_pd(kLog[0]);
+        for( size_t k = 1; k < std::size(kLog); ++k )
+            q = _mm_add_pd(_mm_mul_pd(q, t2), _mm_set1_pd(kLog[k]));
+        const __m128d two_t = _mm_mul_pd(two, t);
+        const __m128d ln_m = _mm_add_pd(two_t, _mm_mul_pd(_mm_mul_pd(two_t, t2), q));
+        const __m128d ln_r = _mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(kLn2Hi)),
+                                        _mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(kLn2Lo)), ln_m));
+        const __m128d ym = _mm_mul_pd(_mm_div_pd(_mm_mul_pd(half, ln_r), two), earth_radius);
+
+        _mm_storeu_pd(x + i, _mm_div_pd(_mm_sub_pd(xm, origin_x), scale));
+        _mm_storeu_pd(y + i, _mm_div_pd(_mm_sub_pd(ym, origin_y), scale));
+    }
+    return i;
+}
+
+OSM_TARGET_AVX2
+size_t ProjectAVX2(const MercatorProjection &p, const double *lat, const double *lon, double *x, double *y,
+                   size_t count)
+{
+    const __m256d deg_to_rad = _mm256_set1_pd(kDegToRad);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d one = _mm256_set1_pd(1.);
+    const __m256d two = _mm256_set1_pd(2.);
+    const __m256d earth_radius = _mm256_set1_pd(kEarthRadius);
+    const __m256d origin_x = _mm256_set1_pd(p.origin_x);
+    const __m256d origin_y = _mm256_set1_pd(p.origin_y);
+    const __m256d scale = _mm256_set1_pd(p.scale);
+    const __m256i mantissa_mask = _mm256_set1_epi64x((long long)kMantissaMask);
+    const __m256i exponent_one = _mm256_set1_epi64x((long long)kExponentOne);
+    const __m256i two52_bits = _mm256_set1_epi64x((long long)kTwo52Bits);
+    const __m256d exponent_offset = _mm256_set1_pd(kTwo52 + kExponentBias);
+
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4 ) {
+        const __m256d vlon = _mm256_loadu_pd(lon + i);
+        const __m256d vlat = _mm256_loadu_pd(lat + i);
+        const __m256d xm = _mm256_mul_pd(_mm256_div_pd(_mm256_mul_pd(vlon, deg_to_rad), two), earth_radius);
+
+        const __m256d a = _mm256_mul_pd(vlat, deg_to_rad);
+        const __m256d a2 = _mm256_mul_pd(a, a);
+        __m256d sp = _mm256_set1_pd(kSin[0]);
+        for( size_t k = 1; k < std::size(kSin); ++k )
+            sp = _mm256_add_pd(_mm256_mul_pd(sp, a2), _mm256_set1_pd(kSin[k]));
+        const __m256d s = _mm256_add_pd(a, _mm256_mul_pd(_mm256_mul_pd(a, a2), sp));
+        const __m256d r = _mm256_div_pd(_mm256_add_pd(one, s), _mm256_sub_pd(one, s));
+
+        const __m256i bits = _mm256_castpd_si256(r);
+        __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissa_mask), exponent_one));
+        __m256d e = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), two52_bits));
+        e = _mm256_sub_pd(e, exponent_offset);
+        const __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(kSqrt2), _CMP_GT_OQ);
+        m = _mm256_blendv_pd(m, _mm256_mul_pd(m, half), big);
+        e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+
+        const __m256d t = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+        const __m256d t2 = _mm256_mul_pd(t, t);
+        __m256d q = _mm256_set1_pd(kLog[0]);
+        for( size_t k = 1; k < std::size(kLog); ++k )
+            q = _mm256_add_pd(_mm256_mul_pd(q, t2), _mm256_set1_pd(kLog[k]));
+        const __m256d two_t = _mm256_mul_pd(two, t);
+        const __m256d ln_m = _mm256_add_pd(two_t, _mm256_mul_pd(_mm256_mul_pd(two_t, t2), q));
+        const __m256d ln_r = _mm256_add_pd(_mm256_mul_pd(e, _mm256_set1_pd(kLn2Hi)),
+                                           _mm256_add_pd(_mm256_mul_pd(e, _mm256_set1_pd(kLn2Lo)), ln_m));
+        const __m256d ym = _mm256_mul_pd(_mm256_div_pd(_mm256_mul_pd(half, ln_r), two), earth_radius);
+
+        _mm256_storeu_pd(x + i, _mm256_div_pd(_mm256_sub_pd(xm, origin_x), scale));
+        _mm256_storeu_pd(y + i, _mm256_div_pd(_mm256_sub_pd(ym, origin_y), scale));
+    }
+    return i;
+}
+
+#endif
+
+}
+
+MercatorProjection MercatorProjection::FromBounds( double min_lat, double max_lat, double min_lon, double max_lon )
+{
+    MercatorProjection p;
+    const auto dx = p.ProjectLon(max_lon) - p.ProjectLon(min_lon);
+    const auto dy = p.ProjectLat(max_lat) - p.ProjectLat(min_lat);
+    p.origin_y = p.ProjectLat(min_lat);
+    p.origin_x = p.ProjectLon(min_lon);
+    p.scale = std::min(dx, dy);
+    return p;
+}
+
+double MercatorProjection::ProjectLat( double lat ) const noexcept
+{
+    const auto ym = log(tan(lat * kDegToRad / 2 + kPi / 4)) / 2 * kEarthRadius;
+    return (ym - origin_y) / scale;
+}
+
+double MercatorProjection::ProjectLon( double lon ) const noexcept
+{
+    const auto xm = lon * kDegToRad / 2 * kEarthRadius;
+    return (xm - origin_x) / scale;
+}
+
+void MercatorProjection::Project( const double *lat, const double *lon, double *x, double *y, std::size_t count ) const
+{
+    Project(lat, lon, x, y, count, BestSimdLevel());
+}
+
+void MercatorProjection::Project( const double *lat, const double *lon, double *x, double *y, std::size_t count,
+                                  SimdLevel level ) const
+{
+    size_t done = 0;
+#if OSM_SIMD_X86
+    if( level == SimdLevel::AVX2 && IsSupported(SimdLevel::AVX2) )
+        done = ProjectAVX2(*this, lat, lon, x, y, count);
+    else if( level != SimdLevel::Scalar && IsSupported(SimdLevel::SSE2) )
+        done = ProjectSSE2(*this, lat, lon, x, y, count);
+#endif
+    ProjectScalar(*this, lat, lon, x, y, done, count);
+}
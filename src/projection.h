@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include "simd.h"
+
+// Spherical Mercator projection of latitude/longitude in degrees into model
+// units: metres relative to the south-west corner of the map bounds, divided
+// by the metric scale.
+struct MercatorProjection {
+    double origin_x = 0.;
+    double origin_y = 0.;
+    double scale = 1.;
+
+    static MercatorProjection FromBounds( double min_lat, double max_lat, double min_lon, double max_lon );
+
+    // Projects count coordinates from contiguous lat/lon arrays into x/y arrays,
+    // the input and output arrays may alias. Uses the best kernel for this CPU.
+    void Project( const double *lat, const double *lon, double *x, double *y, std::size_t count ) const;
+    void Project( const double *lat, const double *lon, double *x, double *y, std::size_t count,
+                  SimdLevel level ) const;
+
+    // Reference per-coordinate projection through std::log/std::tan.
+    double ProjectLat( double lat ) const noexcept;
+    double ProjectLon( double lon ) const noexcept;
+};
@@ -6,8 +6,9 @@ static io2d::rgba_color RoadColor(Model::Road::Type type);
 static io2d::dashes RoadDashes(Model::Road::Type type);
 static io2d::point_2d ToPoint2D( const Model::Node &node ) noexcept; 
 
-Render::Render( RouteModel &model ):
-    m_Model(model)
+Render::Render( const RouteModel &model, std::vector<Model::Node> path ):
+    m_Model(model),
+    m_Path(std::move(path))
 {
     BuildRoadReps();
     BuildLanduseBrushes();
@@ -41,14 +42,14 @@ void Render::DrawPath(io2d::output_surface &surface) const{
 }
 
 void Render::DrawEndPosition(io2d::output_surface &surface) const{
-    if (m_Model.path.empty()) return;
+    if (m_Path.empty()) return;
     io2d::render_props aliased{ io2d::antialias::none };
     io2d::brush foreBrush{ io2d::rgba_color::red };
 
     auto pb = io2d::path_builder{}; 
     pb.matrix(m_Matrix);
 
-    pb.new_figure({(float) m_Model.path.back().x, (float) m_Model.path.back().y});
+    pb.new_figure({(float) m_Path.back().x, (float) m_Path.back().y});
     float constexpr l_marker = 0.01f;
     pb.rel_line({l_marker, 0.f});
     pb.rel_line({0.f, l_marker});
@@ -61,7 +62,7 @@ void Render::DrawEndPosition(io2d::output_surface &surface) const{
 }
 
 void Render::DrawStartPosition(io2d::output_surface &surface) const{
-    if (m_Model.path.empty()) return;
+    if (m_Path.empty()) return;
 
     io2d::render_props aliased{ io2d::antialias::none };
     io2d::brush foreBrush{ io2d::rgba_color::green };
@@ -69,7 +70,7 @@ void Render::DrawStartPosition(io2d::output_surface &surface) const{
     auto pb = io2d::path_builder{}; 
     pb.matrix(m_Matrix);
 
-    pb.new_figure({(float) m_Model.path.front().x, (float) m_Model.path.front().y});
+    pb.new_figure({(float) m_Path.front().x, (float) m_Path.front().y});
     float constexpr l_marker = 0.01f;
     pb.rel_line({l_marker, 0.f});
     pb.rel_line({0.f, l_marker});
@@ -114,11 +115,11 @@ void Render::DrawLanduses(io2d::output_surface &surface) const
 
 void Render::DrawHighways(io2d::output_surface &surface) const
 {
-    auto ways = m_Model.Ways().data();
+    auto &ways = m_Model.Ways();
     for( auto road: m_Model.Roads() )
         if( auto rep_it = m_RoadReps.find(road.type); rep_it != m_RoadReps.end() ) {
             auto &rep = rep_it->second;   
-            auto &way = ways[road.way];
+            auto way = ways[road.way];
             auto width = rep.metric_width > 0.f ? (rep.metric_width * m_PixelsInMeter) : 1.f;
             auto sp = io2d::stroke_props{width, io2d::line_cap::round};
             surface.stroke(rep.brush, PathFromWay(way), std::nullopt, sp, rep.dashes);        
@@ -127,9 +128,9 @@ void Render::DrawHighways(io2d::output_surface &surface) const
 
 void Render::DrawRailways(io2d::output_surface &surface) const
 {     
-    auto ways = m_Model.Ways().data();
+    auto &ways = m_Model.Ways();
     for( auto &railway: m_Model.Railways() ) {
-        auto &way = ways[railway.way];
+        auto way = ways[railway.way];
         auto path = PathFromWay(way);
         surface.stroke(m_RailwayStrokeBrush, path, std::nullopt, io2d::stroke_props{m_RailwayOuterWidth * m_PixelsInMeter});
         surface.stroke(m_RailwayDashBrush, path, std::nullopt, io2d::stroke_props{m_RailwayInnerWidth * m_PixelsInMeter}, m_RailwayDashes);
@@ -138,17 +139,15 @@ void Render::DrawRailways(io2d::output_surface &surface) const
 
 io2d::interpreted_path Render::PathLine() const
 {    
-    if( m_Model.path.empty() )
+    if( m_Path.empty() )
         return {};
 
-    const auto nodes = m_Model.path;    
-    
     auto pb = io2d::path_builder{};
     pb.matrix(m_Matrix);
-    pb.new_figure( ToPoint2D( m_Model.path[0]));
+    pb.new_figure( ToPoint2D( m_Path[0]));
 
-    for( int i=1; i< m_Model.path.size();i++ )
-        pb.line( ToPoint2D(m_Model.path[i])); 
+    for( int i=1; i< m_Path.size();i++ )
+        pb.line( ToPoint2D(m_Path[i])); 
 
       
     return io2d::interpreted_path{pb};
@@ -159,20 +158,20 @@ io2d::interpreted_path Render::PathFromWay(const Model::Way &way) const
     if( way.nodes.empty() )
         return {};
 
-    const auto nodes = m_Model.Nodes().data();    
+    auto &nodes = m_Model.Nodes();    
     
     auto pb = io2d::path_builder{};
     pb.matrix(m_Matrix);
     pb.new_figure( ToPoint2D(nodes[way.nodes.front()]) );
-    for( auto it = ++way.nodes.begin(); it != std::end(way.nodes); ++it )
+    for( auto it = std::next(way.nodes.begin()); it != way.nodes.end(); ++it )
         pb.line( ToPoint2D(nodes[*it]) );     
     return io2d::interpreted_path{pb};
 }
 
 io2d::interpreted_path Render::PathFromMP(const Model::Multipolygon &mp) const
 {
-    const auto nodes = m_Model.Nodes().data();
-    const auto ways = m_Model.Ways().data();
+    auto &nodes = m_Model.Nodes();
+    auto &ways = m_Model.Ways();
 
     auto pb = io2d::path_builder{};    
     pb.matrix(m_Matrix);    
@@ -181,7 +180,7 @@ io2d::interpreted_path Render::PathFromMP(const Model::Multipolygon &mp) const
         if( way.nodes.empty() )
             return;
         pb.new_figure( ToPoint2D(nodes[way.nodes.front()]) );
-        for( auto it = ++way.nodes.begin(); it != std::end(way.nodes); ++it )
+        for( auto it = std::next(way.nodes.begin()); it != way.nodes.end(); ++it )
             pb.line( ToPoint2D(nodes[*it]) );        
         pb.close_figure();        
     };
@@ -0,0 +1,140 @@
+#include "route_graph.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "snapshot_io.h"
+
+RouteGraph::RouteGraph(const Model &model) {
+    struct Edge {
+        int from;
+        int to;
+        float length;
+    };
+
+    // Both directions of every segment between consecutive road nodes.
+    std::vector<Edge> edges;
+    auto &nodes = model.Nodes();
+    for (const Model::Road &road : model.Roads()) {
+        if (road.type == Model::Road::Type::Footway)
+            continue;
+        auto way_nodes = model.Ways()[road.way].nodes;
+        for (size_t i = 1; i < way_nodes.size(); ++i) {
+            int a = way_nodes[i - 1], b = way_nodes[i];
+            if (a == b)
+                continue;
+            auto length = (float)std::hypot(nodes.X(a) - nodes.X(b), nodes.Y(a) - nodes.Y(b));
+            edges.push_back({a, b, length});
+            edges.push_back({b, a, length});
+        }
+    }
+
+    std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+        return a.from != b.from ? a.from < b.from : a.to != b.to ? a.to < b.to : a.length < b.length;
+    });
+    edges.erase(std::unique(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+        return a.from == b.from && a.to == b.to;
+    }), edges.end());
+
+    m_Offsets.assign(nodes.size() + 1, 0);
+    m_Targets.reserve(edges.size());
+    m_Lengths.reserve(edges.size());
+    for (const Edge &edge : edges) {
+        ++m_Offsets[edge.from + 1];
+        m_Targets.push_back(edge.to);
+        m_Lengths.push_back(edge.length);
+    }
+    for (size_t i = 1; i < m_Offsets.size(); ++i)
+        m_Offsets[i] += m_Offsets[i - 1];
+}
+
+
+RouteGraph::RouteGraph(SnapshotReader &reader, int node_count) {
+    reader.GetArray(m_Offsets);
+    reader.GetArray(m_Targets);
+    reader.GetArray(m_Lengths);
+    CheckSnapshotOffsets(m_Offsets, node_count, m_Targets.size());
+    CheckSnapshotIndices(m_Targets, node_count);
+    if (m_Lengths.size() != m_Targets.size())
+        throw std::logic_error("snapshot is corrupted");
+    for (float length : m_Lengths)
+        if (!(length >= 0.0f))
+            throw std::logic_error("snapshot is corrupted");
+}
+
+
+void RouteGraph::Save(SnapshotWriter &writer) const {
+    writer.PutArray(m_Offsets);
+    writer.PutArray(m_Targets);
+    writer.PutArray(m_Lengths);
+}
+
+
+// The three arrays are hashed apart and their hashes hashed together, so that
+// moving bytes from one array to the next changes the result.
+std::uint64_t RouteGraph::Checksum() const {
+    auto bytes = [](const auto &v) { return reinterpret_cast<const std::byte *>(v.data()); };
+    std::uint64_t parts[3] = {::Checksum(bytes(m_Offsets), m_Offsets.size() * sizeof(std::uint32_t)),
+                              ::Checksum(bytes(m_Targets), m_Targets.size() * sizeof(int)),
+                              ::Checksum(bytes(m_Lengths), m_Lengths.size() * sizeof(float))};
+    return ::Checksum(reinterpret_cast<const std::byte *>(parts), sizeof(parts));
+}
+
+
+GraphComponents::GraphComponents(const RouteGraph &graph) : m_Labels(graph.NodeCount(), -1) {
+    // Depth-first labelling in node order, so each component's first node is its lowest.
+    std::vector<int> stack;
+    for (int node = 0; node < graph.NodeCount(); ++node) {
+        if (m_Labels[node] >= 0)
+            continue;
+        int label = (int)m_Sizes.size();
+        m_Sizes.push_back(0);
+        m_Labels[node] = label;
+        stack.push_back(node);
+        while (!stack.empty()) {
+            int current = stack.back();
+            stack.pop_back();
+            ++m_Sizes[label];
+            for (int target : graph.Targets(current))
+                if (m_Labels[target] < 0) {
+                    m_Labels[target] = label;
+                    stack.push_back(target);
+                }
+        }
+    }
+
+    // Renumbers by decreasing size; the stable sort keeps lower first nodes first.
+    std::vector<int> order(m_Sizes.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = (int)i;
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return m_Sizes[a] > m_Sizes[b]; });
+    std::vector<int> rank(order.size());
+    std::vector<std::uint32_t> sizes(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        rank[order[i]] = (int)i;
+        sizes[i] = m_Sizes[order[i]];
+    }
+    for (int &label : m_Labels)
+        label = rank[label];
+    m_Sizes = std::move(sizes);
+}
+
+
+// The sizes are recounted from the labels rather than trusted.
+GraphComponents::GraphComponents(SnapshotReader &reader, const RouteGraph &graph) {
+    reader.GetArray(m_Labels);
+    reader.GetArray(m_Sizes);
+    if (m_Labels.size() != (size_t)graph.NodeCount())
+        throw std::logic_error("snapshot is corrupted");
+    CheckSnapshotIndices(m_Labels, m_Sizes.size());
+    std::vector<std::uint32_t> sizes(m_Sizes.size(), 0);
+    for (int label : m_Labels)
+        ++sizes[label];
+    if (sizes != m_Sizes)
+        throw std::logic_error("snapshot is corrupted");
+}
+
+
+void GraphComponents::Save(SnapshotWriter &writer) const {
+    writer.PutArray(m_Labels);
+    writer.PutArray(m_Sizes);
+}
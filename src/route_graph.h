@@ -0,0 +1,68 @@
+#ifndef ROUTE_GRAPH_H
+#define ROUTE_GRAPH_H
+
+#include <cstdint>
+#include <vector>
+#include "model.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Undirected road network in compressed sparse row form. The edges of node n
+// are [offsets[n], offsets[n + 1]) in targets and lengths, sorted by target.
+// Edges join consecutive nodes of every non-footway road, parallel edges are
+// merged keeping the shortest, and lengths are in model units.
+class RouteGraph {
+  public:
+    RouteGraph() = default;
+    explicit RouteGraph(const Model &model);
+    // Reads back what Save() wrote for a graph over node_count nodes.
+    RouteGraph(SnapshotReader &reader, int node_count);
+    void Save(SnapshotWriter &writer) const;
+
+    int NodeCount() const { return (int)m_Offsets.size() - 1; }
+    size_t EdgeCount() const { return m_Targets.size(); }
+    int Degree(int node) const { return (int)(m_Offsets[node + 1] - m_Offsets[node]); }
+    Span<const int> Targets(int node) const { return {m_Targets.data() + m_Offsets[node], (size_t)Degree(node)}; }
+    Span<const float> Lengths(int node) const { return {m_Lengths.data() + m_Offsets[node], (size_t)Degree(node)}; }
+    // Checksum of the offsets, targets and lengths, to tell whether tables
+    // computed for one graph still belong to another.
+    std::uint64_t Checksum() const;
+
+    size_t Bytes() const {
+        return m_Offsets.capacity() * sizeof(std::uint32_t) + m_Targets.capacity() * sizeof(int) +
+               m_Lengths.capacity() * sizeof(float);
+    }
+
+  private:
+    std::vector<std::uint32_t> m_Offsets{0};
+    std::vector<int> m_Targets;
+    std::vector<float> m_Lengths;
+};
+
+// Connected components of a RouteGraph, numbered by decreasing size, ties by
+// their lowest node, so component 0 is the largest. The graph is undirected,
+// so weak and strong components are the same. Nodes without edges are
+// components of their own.
+class GraphComponents {
+  public:
+    GraphComponents() = default;
+    explicit GraphComponents(const RouteGraph &graph);
+    // Reads back what Save() wrote for the components of graph.
+    GraphComponents(SnapshotReader &reader, const RouteGraph &graph);
+    void Save(SnapshotWriter &writer) const;
+
+    int Count() const { return (int)m_Sizes.size(); }
+    int Of(int node) const { return m_Labels[node]; }
+    size_t Size(int component) const { return m_Sizes[component]; }
+    // Component number of every node.
+    Span<const int> Labels() const { return {m_Labels.data(), m_Labels.size()}; }
+
+    size_t Bytes() const { return m_Labels.capacity() * sizeof(int) + m_Sizes.capacity() * sizeof(std::uint32_t); }
+
+  private:
+    std::vector<int> m_Labels;
+    std::vector<std::uint32_t> m_Sizes;
+};
+
+#endif
@@ -1,77 +1,139 @@
 #include "route_model.h"
 #include <iostream>
+#include <stdexcept>
+#include "snapshot_io.h"
 
-RouteModel::RouteModel(const std::vector<std::byte> &xml) : Model(xml) {
-    // Create RouteModel nodes.
-    int counter = 0;
-    for (Model::Node node : this->Nodes()) {
-        m_Nodes.emplace_back(Node(counter, this, node));
-        counter++;
+RouteModel::RouteModel(Span<const std::byte> data) : RouteModel(data, LoadOptions{}) {}
+
+
+RouteModel::RouteModel(Span<const std::byte> data, const LoadOptions &options) : Model(data, options) {
+    using Phase = LoadStats::Phase;
+    using Container = LoadStats::Container;
+    if (!m_ExtraSections.empty()) {
+        PhaseTimer timer{m_Stats, Phase::Snapshot};
+        LoadExtraSections();
     }
-    CreateNodeToRoadHashmap();
-}
+    else {
+        PhaseTimer timer{m_Stats, Phase::NodeToRoad};
+        CreateNodeToRoadIndex();
 
+        timer.Enter(Phase::RouteGraph);
+        m_Graph = RouteGraph{*this};
 
-void RouteModel::CreateNodeToRoadHashmap() {
-    for (const Model::Road &road : Roads()) {
-        if (road.type != Model::Road::Type::Footway) {
-            for (int node_idx : Ways()[road.way].nodes) {
-                if (node_to_road.find(node_idx) == node_to_road.end()) {
-                    node_to_road[node_idx] = std::vector<const Model::Road *> ();
-                }
-                node_to_road[node_idx].push_back(&road);
-            }
-        }
+        timer.Enter(Phase::Components);
+        m_Components = GraphComponents{m_Graph};
+
+        timer.Enter(Phase::SpatialIndex);
+        CreateNodeIndex();
+
+        timer.Enter(Phase::SegmentIndex);
+        m_SegmentIndex = SegmentGrid{*this, m_Graph};
     }
+
+    m_Stats.usage[(size_t)Container::NodeToRoad] = {
+        m_NodeRoads.size(), LoadStats::Bytes(m_NodeRoadOffsets) + LoadStats::Bytes(m_NodeRoads)};
+    m_Stats.usage[(size_t)Container::RouteGraph] = {m_Graph.EdgeCount(), m_Graph.Bytes()};
+    m_Stats.usage[(size_t)Container::Components] = {(size_t)m_Components.Count(), m_Components.Bytes()};
+    m_Stats.usage[(size_t)Container::SpatialIndex] = {m_NodeIndex.Size(), m_NodeIndex.Bytes()};
+    m_Stats.usage[(size_t)Container::SegmentIndex] = {m_SegmentIndex.SegmentCount(), m_SegmentIndex.Bytes()};
 }
 
 
-RouteModel::Node * RouteModel::Node::FindNeighbor(std::vector<int> node_indices) {
-    Node *closest_node = nullptr;
-    Node node;
+// Two passes over the roads: the first counts the roads of each node, the
+// second fills them in after the prefix sum. A node listed twice by one way,
+// as closed ways do, is given that road once: its last road so far is the
+// one being walked, since roads are visited in order.
+void RouteModel::CreateNodeToRoadIndex() {
+    auto &roads = Roads();
+    auto for_each_road_node = [&](auto f) {
+        for (size_t road = 0; road < roads.size(); ++road)
+            if (roads[road].type != Model::Road::Type::Footway)
+                for (int node_idx : Ways()[roads[road].way].nodes)
+                    f(node_idx, (int)road);
+    };
 
-    for (int node_index : node_indices) {
-        node = parent_model->SNodes()[node_index];
-        if (this->distance(node) != 0 && !node.visited) {
-            if (closest_node == nullptr || this->distance(node) < this->distance(*closest_node)) {
-                closest_node = &parent_model->SNodes()[node_index];
-            }
+    std::vector<int> last_road(Nodes().size(), -1);
+    m_NodeRoadOffsets.assign(Nodes().size() + 1, 0);
+    for_each_road_node([&](int node_idx, int road) {
+        if (last_road[node_idx] != road) {
+            last_road[node_idx] = road;
+            ++m_NodeRoadOffsets[node_idx + 1];
         }
-    }
-    return closest_node;
+    });
+    for (size_t i = 1; i < m_NodeRoadOffsets.size(); ++i)
+        m_NodeRoadOffsets[i] += m_NodeRoadOffsets[i - 1];
+
+    m_NodeRoads.resize(m_NodeRoadOffsets.back());
+    std::vector<std::uint32_t> next(m_NodeRoadOffsets.begin(), m_NodeRoadOffsets.end() - 1);
+    for_each_road_node([&](int node_idx, int road) {
+        if (next[node_idx] == m_NodeRoadOffsets[node_idx] || m_NodeRoads[next[node_idx] - 1] != road)
+            m_NodeRoads[next[node_idx]++] = road;
+    });
 }
 
 
-void RouteModel::Node::FindNeighbors() {
-    for (auto & road : parent_model->node_to_road[this->index]) {
-        RouteModel::Node *new_neighbor = this->FindNeighbor(parent_model->Ways()[road->way].nodes);
-        if (new_neighbor) {
-            this->neighbors.emplace_back(new_neighbor);
-        }
-    }
+// Sections in the order SaveExtraSections() writes them. Every index is
+// checked against the model it was loaded with.
+void RouteModel::LoadExtraSections() {
+    SnapshotReader reader{m_ExtraSections.data(), m_ExtraSections.data() + m_ExtraSections.size()};
+    m_ExtraSections = {};
+    int node_count = (int)Nodes().size();
+    reader.GetArray(m_NodeRoadOffsets);
+    reader.GetArray(m_NodeRoads);
+    CheckSnapshotOffsets(m_NodeRoadOffsets, node_count, m_NodeRoads.size());
+    CheckSnapshotIndices(m_NodeRoads, Roads().size());
+    m_Graph = RouteGraph{reader, node_count};
+    m_Components = GraphComponents{reader, m_Graph};
+    m_NodeIndex = KdTree{reader, node_count};
+    m_SegmentIndex = SegmentGrid{reader, node_count};
 }
 
 
-RouteModel::Node &RouteModel::FindClosestNode(float x, float y) {
-    Node input;
-    input.x = x;
-    input.y = y;
-
-    float min_dist = std::numeric_limits<float>::max();
-    float dist;
-    int closest_idx;
-
-    for (const Model::Road &road : Roads()) {
-        if (road.type != Model::Road::Type::Footway) {
-            for (int node_idx : Ways()[road.way].nodes) {
-                dist = input.distance(SNodes()[node_idx]);
-                if (dist < min_dist) {
-                    closest_idx = node_idx;
-                    min_dist = dist;
-                }
-            }
-        }
-    }
+void RouteModel::SaveExtraSections(SnapshotWriter &writer) const {
+    writer.PutArray(m_NodeRoadOffsets);
+    writer.PutArray(m_NodeRoads);
+    m_Graph.Save(writer);
+    m_Components.Save(writer);
+    m_NodeIndex.Save(writer);
+    m_SegmentIndex.Save(writer);
+}
+
+
+// Every node of a non-footway road, once, in a k-d tree.
+void RouteModel::CreateNodeIndex() {
+    auto &nodes = Nodes();
+    std::vector<KdTree::Point> points;
+    for (int node_idx = 0; node_idx < (int)nodes.size(); ++node_idx)
+        if (!NodeRoads(node_idx).empty())
+            points.push_back({(float)nodes.X(node_idx), (float)nodes.Y(node_idx), node_idx});
+    m_NodeIndex = KdTree{std::move(points)};
+}
+
+
+// The largest component holds every edge of a connected map; snapping to it
+// only falls back to the whole network if it has no edges at all.
+RouteModel::Node RouteModel::FindClosestNode(float x, float y, SnapScope scope) const {
+    int node_idx = -1;
+    if (scope == SnapScope::LargestComponent)
+        node_idx = m_NodeIndex.Nearest(x, y, m_Components.Labels(), 0);
+    if (node_idx < 0)
+        node_idx = m_NodeIndex.Nearest(x, y);
+    if (node_idx < 0)
+        throw std::logic_error("the map has no routable roads");
+    return RouteNode(node_idx);
+}
+
+
+EdgePoint RouteModel::SnapToEdge(float x, float y, SnapScope scope) const {
+    if (scope == SnapScope::LargestComponent)
+        return m_SegmentIndex.Nearest(x, y, m_Components.Labels(), 0);
+    return m_SegmentIndex.Nearest(x, y);
+}
+
 
-    return SNodes()[closest_idx];
-}
\ No newline at end of file
+std::vector<RouteModel::Node> RouteModel::FindClosestNodes(float x, float y, size_t k) const {
+    std::vector<Node> closest;
+    for (int node_idx : m_NodeIndex.Nearest(x, y, k))
+        closest.push_back(RouteNode(node_idx));
+    return closest;
+}
@@ -1,46 +1,91 @@
 #ifndef ROUTE_MODEL_H
 #define ROUTE_MODEL_H
 
+#include <cstdint>
 #include <limits>
 #include <cmath>
-#include <unordered_map>
 #include "model.h"
+#include "route_graph.h"
+#include "kd_tree.h"
+#include "segment_grid.h"
 #include <iostream>
 
 class RouteModel : public Model {
 
   public:
-    class Node : public Model::Node {
+    // A node of the road network by its number in Nodes() and Graph(). The
+    // position is read from the model's NodeStore when asked for, never copied.
+    // Search state is kept per query in a SearchWorkspace, so the model stays
+    // immutable.
+    class Node {
       public:
-        Node * parent = nullptr;
-        float h_value = std::numeric_limits<float>::max();
-        float g_value = 0.0;
-        bool visited = false;
-        std::vector<Node *> neighbors;
-
-        void FindNeighbors();
-        float distance(Node other) const {
-            return std::sqrt(std::pow((x - other.x), 2) + std::pow((y - other.y), 2));
-        }
+        int Index() const { return index; }
+        Model::Node Position() const { return (*m_Store)[index]; }
+        double X() const { return m_Store->X(index); }
+        double Y() const { return m_Store->Y(index); }
 
         Node(){}
-        Node(int idx, RouteModel * search_model, Model::Node node) : Model::Node(node), parent_model(search_model), index(idx) {}
+        Node(const NodeStore &store, int idx) : m_Store(&store), index(idx) {}
 
       private:
-        int index;
-        Node * FindNeighbor(std::vector<int> node_indices);
-        RouteModel * parent_model = nullptr;
+        const NodeStore *m_Store = nullptr;
+        int index = -1;
     };
 
-    RouteModel(const std::vector<std::byte> &xml);
-    Node &FindClosestNode(float x, float y);
-    auto &SNodes() { return m_Nodes; }
-    std::vector<Node> path;
+    // Straight-line distance between two positions, in model units.
+    static float Distance(const Model::Node &a, const Model::Node &b) {
+        double dx = a.x - b.x, dy = a.y - b.y;
+        return (float)std::sqrt(dx * dx + dy * dy);
+    }
+
+    // Where snapping may land: anywhere on the road network, or only on its
+    // largest connected component, from which most of the map can be reached.
+    enum class SnapScope { AnyComponent, LargestComponent };
+
+    RouteModel(Span<const std::byte> data);
+    RouteModel(Span<const std::byte> data, const LoadOptions &options);
+    // Closest routable node, a node of a non-footway road, looked up in a k-d
+    // tree. Throws std::logic_error if the map has none.
+    Node FindClosestNode(float x, float y, SnapScope scope = SnapScope::AnyComponent) const;
+    // The k closest routable nodes, nearest first.
+    std::vector<Node> FindClosestNodes(float x, float y, size_t k) const;
+    // FindClosestNode for a batch of points: the node numbers and the distances
+    // to them, in model units. Faster per point than one call each. Throws
+    // std::invalid_argument unless all four spans have the same size.
+    void SnapToNodes(Span<const float> x, Span<const float> y, Span<int> nodes, Span<float> distances) const {
+        m_NodeIndex.Nearest(x, y, nodes, distances);
+    }
+    // Projection onto the closest road segment, an edge of Graph(), through a grid of segments.
+    EdgePoint SnapToEdge(float x, float y, SnapScope scope = SnapScope::AnyComponent) const;
+    // Handle to the node with the given number in Nodes().
+    Node RouteNode(int index) const { return {Nodes(), index}; }
+    // Numbers in Roads() of the non-footway roads through a node, in road
+    // order and each once; empty for nodes off the road network.
+    Span<const int> NodeRoads(int node) const {
+        return {m_NodeRoads.data() + m_NodeRoadOffsets[node], m_NodeRoadOffsets[node + 1] - m_NodeRoadOffsets[node]};
+    }
+    const RouteGraph &Graph() const { return m_Graph; }
+    // Connected components of Graph(); two nodes are joined by a route exactly
+    // if they are in the same one.
+    const GraphComponents &Components() const { return m_Components; }
     
+  protected:
+    // The node-to-road index, graph, components and both spatial indices, so
+    // that a snapshot loads with them already built.
+    void SaveExtraSections(SnapshotWriter &writer) const override;
+
   private:
-    void CreateNodeToRoadHashmap();
-    std::unordered_map<int, std::vector<const Model::Road *>> node_to_road;
-    std::vector<Node> m_Nodes;
+    void CreateNodeToRoadIndex();
+    void CreateNodeIndex();
+    void LoadExtraSections();
+    // Compressed sparse row form: the roads of node n are
+    // [m_NodeRoadOffsets[n], m_NodeRoadOffsets[n + 1]) in m_NodeRoads.
+    std::vector<std::uint32_t> m_NodeRoadOffsets;
+    std::vector<int> m_NodeRoads;
+    RouteGraph m_Graph;
+    GraphComponents m_Components;
+    KdTree m_NodeIndex;
+    SegmentGrid m_SegmentIndex;
 
 };
 
@@ -1,65 +1,199 @@
 #include "route_planner.h"
 #include <algorithm>
+#include <limits>
 
-RoutePlanner::RoutePlanner(RouteModel &model, float start_x, float start_y, float end_x, float end_y): m_Model(model) {
+template <typename Queue>
+BasicRoutePlanner<Queue>::BasicRoutePlanner(const RouteModel &model, float start_x, float start_y, float end_x, float end_y,
+                                            Snap snap, SnapScope scope):
+    BasicRoutePlanner(model, m_OwnWorkspace, start_x, start_y, end_x, end_y, snap, scope) {}
+
+template <typename Queue>
+BasicRoutePlanner<Queue>::BasicRoutePlanner(const RouteModel &model, Workspace_t &workspace,
+                                            float start_x, float start_y, float end_x, float end_y, Snap snap,
+                                            SnapScope scope):
+    m_Model(model), m_Workspace(workspace) {
     // Convert inputs to percentage:
     start_x *= 0.01;
     start_y *= 0.01;
     end_x *= 0.01;
     end_y *= 0.01;
 
-    // UPDATE 2: Use the m_Model.FindClosestNode method to find the closest nodes to the starting and ending coordinates.
-    // Store the nodes you find in the RoutePlanner's start_node and end_node attributes.
-    this->start_node = &m_Model.FindClosestNode(start_x, start_y);
-    this->end_node = &m_Model.FindClosestNode(end_x, end_y);
+    if (snap == Snap::Edge) {
+        m_Snapped[0] = m_Model.SnapToEdge(start_x, start_y, scope);
+        m_Snapped[1] = m_Model.SnapToEdge(end_x, end_y, scope);
+        if (m_Snapped[0].from >= 0 && m_Snapped[1].from >= 0) {
+            for (int i = 0; i < 2; ++i)
+                m_Virtual[i] = Model::Node{m_Snapped[i].x, m_Snapped[i].y};
+            m_VirtualCount = 2;
+            this->start_node = (int)m_Model.Nodes().size();
+            this->end_node = this->start_node + 1;
+        }
+    }
+    if (m_VirtualCount == 0) {
+        // UPDATE 2: Use the m_Model.FindClosestNode method to find the closest nodes to the starting and ending coordinates.
+        // Store the nodes you find in the RoutePlanner's start_node and end_node attributes.
+        this->start_node = m_Model.FindClosestNode(start_x, start_y, scope).Index();
+        this->end_node = m_Model.FindClosestNode(end_x, end_y, scope).Index();
+    }
+
+    m_Workspace.Reset(this->NodeCount());
+}
+
+
+// Positions are read from the model's NodeStore, or the planner's own for
+// virtual nodes.
+template <typename Queue>
+Model::Node BasicRoutePlanner<Queue>::Position(int index) const {
+    auto &nodes = m_Model.Nodes();
+    int node_count = (int)nodes.size();
+    return index < node_count ? nodes[index] : m_Virtual[index - node_count];
+}
+
+
+// A virtual node is in the component of the segment it lies on.
+template <typename Queue>
+int BasicRoutePlanner<Queue>::Component(int index) const {
+    int node_count = (int)m_Model.Nodes().size();
+    return m_Model.Components().Of(index < node_count ? index : m_Snapped[index - node_count].from);
+}
+
+
+// Calls f(target, length) for each edge of node: its edges in the graph and,
+// with virtual nodes, the pieces of their segments that join them to the
+// segment's ends, or to each other when both lie on one segment.
+template <typename Queue>
+template <typename F>
+void BasicRoutePlanner<Queue>::ForEachEdge(int node, F f) const {
+    int node_count = (int)m_Model.Nodes().size();
+    if (node < node_count) {
+        const RouteGraph &graph = m_Model.Graph();
+        auto targets = graph.Targets(node);
+        auto lengths = graph.Lengths(node);
+        for (size_t i = 0; i < targets.size(); ++i)
+            f(targets[i], lengths[i]);
+    }
+    for (int i = 0; i < m_VirtualCount; ++i) {
+        const EdgePoint &point = m_Snapped[i];
+        int virtual_node = node_count + i;
+        if (node == virtual_node) {
+            f(point.from, this->Distance(virtual_node, point.from));
+            f(point.to, this->Distance(virtual_node, point.to));
+            const EdgePoint &other = m_Snapped[1 - i];
+            if (other.from == point.from && other.to == point.to)
+                f(node_count + 1 - i, this->Distance(virtual_node, node_count + 1 - i));
+        }
+        else if (node == point.from || node == point.to) {
+            f(virtual_node, this->Distance(node, virtual_node));
+        }
+    }
+}
+
+
+// Straight-line distance, raised to the landmark bound when there are landmarks.
+// Both are consistent, and so is their maximum.
+template <typename Queue>
+float BasicRoutePlanner<Queue>::LowerBound(int node, int target) const {
+    float bound = this->Distance(node, target);
+    if (m_Landmarks)
+        bound = std::max(bound, this->LandmarkBound(node, target));
+    return bound;
+}
+
+
+// A route from or to a virtual node leaves its segment through one of the
+// segment's ends, so the landmark bound through the closer end holds, unless
+// both virtual nodes lie on one segment.
+template <typename Queue>
+float BasicRoutePlanner<Queue>::LandmarkBound(int node, int target) const {
+    int node_count = (int)m_Model.Nodes().size();
+    if (node < node_count && target < node_count)
+        return m_Landmarks->LowerBound(node, target);
+    if (node >= node_count && target >= node_count && m_Snapped[0].from == m_Snapped[1].from &&
+        m_Snapped[0].to == m_Snapped[1].to)
+        return 0.0f;
+
+    struct End {
+        int node;
+        float offset;
+    };
+    auto ends = [&](int index, End (&out)[2]) {
+        if (index < node_count) {
+            out[0] = {index, 0.0f};
+            return 1;
+        }
+        const EdgePoint &point = m_Snapped[index - node_count];
+        out[0] = {point.from, this->Distance(index, point.from)};
+        out[1] = {point.to, this->Distance(index, point.to)};
+        return 2;
+    };
+    End from[2], to[2];
+    int from_count = ends(node, from), to_count = ends(target, to);
+    float bound = std::numeric_limits<float>::max();
+    for (int i = 0; i < from_count; ++i)
+        for (int j = 0; j < to_count; ++j)
+            bound = std::min(bound, from[i].offset + m_Landmarks->LowerBound(from[i].node, to[j].node) + to[j].offset);
+    return bound;
 }
 
 
 // UPDATE 3: Implement the CalculateHValue method.
 // Tips:
 // - You can use the distance to the end_node for the h value.
-// - Node objects have a distance method to determine the distance to another node.
-float RoutePlanner::CalculateHValue(RouteModel::Node const *node) {
-    return node->distance(*end_node);
+// - Distance gives the straight-line distance between two nodes, read from the model's NodeStore.
+// - With landmarks, LowerBound also uses the triangle inequality over their distance tables.
+template <typename Queue>
+float BasicRoutePlanner<Queue>::CalculateHValue(int node) const {
+    return this->LowerBound(node, end_node);
+}
+
+
+// Records node as reached through parent with the given g value and queues it.
+template <typename Queue>
+void BasicRoutePlanner<Queue>::Open(int node, int parent, float g_value) {
+    m_Workspace.Visit(node);
+    m_Workspace.Parent(node) = parent;
+    m_Workspace.GValue(node) = g_value;
+    m_Workspace.HValue(node) = this->CalculateHValue(node);
+    m_Workspace.Open().Push(node, g_value + m_Workspace.HValue(node));
 }
 
 
 // UPDATE 4: Complete the AddNeighbors method to expand the current node by adding all unvisited neighbors to the open list.
 // Tips:
-// - Use the FindNeighbors() method of the current_node to populate current_node.neighbors vector with all the neighbors.
-// - For each node in current_node.neighbors, set the parent, the h_value, the g_value. 
+// - The neighbors of current_node are its edges in the model's RouteGraph, which join consecutive nodes of a road,
+//   plus the pieces of road joining the virtual start and end nodes, if there are any. ForEachEdge lists them all.
+// - For each unvisited neighbor, set the parent, the h_value and the g_value in the workspace, and push it on the open list.
+// - A neighbor that is still open gets the shorter parent if this edge improves its g_value, and its key is decreased.
+// - Closed neighbors are final and skipped.
 // - Use CalculateHValue below to implement the h-Value calculation.
-// - For each node in current_node.neighbors, add the neighbor to open_list and set the node's visited attribute to true.
-
-void RoutePlanner::AddNeighbors(RouteModel::Node *current_node) {
-    current_node->FindNeighbors();
-    for (RouteModel::Node* node : current_node->neighbors) {
-        if (node->visited == false) {
-            node->parent = current_node;
-            node->g_value = current_node->g_value + current_node->distance(*node);
-            node->h_value = this->CalculateHValue(node);
-            node->visited = true;
-            this->open_list.emplace_back(node);
+
+template <typename Queue>
+void BasicRoutePlanner<Queue>::AddNeighbors(int current) {
+    float current_g = m_Workspace.Visited(current) ? m_Workspace.GValue(current) : 0.0f;
+    this->ForEachEdge(current, [&](int target, float length) {
+        float g_value = current_g + length;
+        if (!m_Workspace.Visited(target)) {
+            this->Open(target, current, g_value);
         }
-    }
+        else if (!m_Workspace.Closed(target) && g_value < m_Workspace.GValue(target)) {
+            m_Workspace.Parent(target) = current;
+            m_Workspace.GValue(target) = g_value;
+            m_Workspace.Open().DecreaseKey(target, g_value + m_Workspace.HValue(target));
+        }
+    });
 }
 
 
-// UPDATE 5: Complete the NextNode method to sort the open list and return the next node.
+// UPDATE 5: Complete the NextNode method to return the next node.
 // Tips:
-// - Sort the open_list according to the sum of the h value and g value.
-// - Create a pointer to the node in the list with the lowest sum.
-// - Remove that node from the open_list.
-// - Return the pointer.
-
-RouteModel::Node *RoutePlanner::NextNode() {
-    std::sort(this->open_list.begin(), this->open_list.end(), 
-              [](RouteModel::Node *a, RouteModel::Node *b)
-              { return ((a->g_value + a->h_value) > (b->g_value + b->h_value)); }
-    );
-    RouteModel::Node *lowest_node = this->open_list.back();
-    this->open_list.pop_back();
-    return lowest_node;
+// - The open list is an indexed heap keyed by the sum of the h value and g value.
+// - Pop the node with the lowest sum, which closes it.
+// - Return its node number.
+
+template <typename Queue>
+int BasicRoutePlanner<Queue>::NextNode() {
+    ++this->settled;
+    return m_Workspace.Open().Pop();
 }
 
 
@@ -71,19 +205,20 @@ RouteModel::Node *RoutePlanner::NextNode() {
 // - The returned vector should be in the correct order: the start node should be the first element
 //   of the vector, the end node should be the last element.
 
-std::vector<RouteModel::Node> RoutePlanner::ConstructFinalPath(RouteModel::Node *current_node) {
+template <typename Queue>
+std::vector<Model::Node> BasicRoutePlanner<Queue>::ConstructFinalPath(int current) {
     // Create path_found vector
     this->distance = 0.0f;
-    std::vector<RouteModel::Node> path_found;
+    std::vector<Model::Node> path_found;
 
     // UPDATE: Implement construct of final path.
-    while (current_node != nullptr) {
-        path_found.emplace_back(*current_node);
-        
-        if (current_node->parent != nullptr) {
-            this->distance += current_node->distance(*current_node->parent);
+    while (current >= 0) {
+        path_found.emplace_back(this->Position(current));
+        int parent = m_Workspace.Visited(current) ? m_Workspace.Parent(current) : -1;
+        if (parent >= 0) {
+            this->distance += this->Distance(current, parent);
         }
-        current_node = current_node->parent;
+        current = parent;
     }
 
     std::reverse(path_found.begin(), path_found.end());
@@ -96,27 +231,115 @@ std::vector<RouteModel::Node> RoutePlanner::ConstructFinalPath(RouteModel::Node
 
 // UPDATE 7: Write the A* Search algorithm here.
 // Tips:
-// - Use the AddNeighbors method to add all of the neighbors of the current node to the open_list.
-// - Use the NextNode() method to sort the open_list and return the next node.
+// - Use the AddNeighbors method to add all of the neighbors of the current node to the open list.
+// - Use the NextNode() method to pop the next node from the open list.
 // - When the search has reached the end_node, use the ConstructFinalPath method to return the final path that was found.
-// - Store the final path in the m_Model.path attribute before the method exits. This path will then be displayed on the map tile.
-
-void RoutePlanner::AStarSearch() {
-    RouteModel::Node *current_node = nullptr;
+// - Store the final path in the planner's path attribute before the method exits, GetPath() hands it to the renderer.
 
+template <typename Queue>
+void BasicRoutePlanner<Queue>::AStarSearch(SearchMode mode) {
     // UPDATE: Implement A* while loop.
-    this->start_node->g_value = 0.0;
-    this->start_node->h_value = this->CalculateHValue(start_node);
-    this->start_node->visited = true;
-    this->open_list.emplace_back(this->start_node);
+    this->path.clear();
+    this->distance = 0.0f;
+    this->settled = 0;
+    // No route leaves a component, so a search would only exhaust the start's.
+    if (this->Component(start_node) != this->Component(end_node))
+        return;
+    if (mode == SearchMode::Bidirectional) {
+        this->BidirectionalSearch();
+        return;
+    }
+    m_Workspace.Reset(this->NodeCount());
+    this->Open(this->start_node, -1, 0.0f);
 
-    while (this->open_list.size() > 0) {
-        current_node = this->NextNode();
+    while (!m_Workspace.Open().Empty()) {
+        int current_node = this->NextNode();
 
         if (current_node == this->end_node) {
-            this->m_Model.path = this->ConstructFinalPath(current_node);
+            this->path = this->ConstructFinalPath(current_node);
             return;
         }
         this->AddNeighbors(current_node);
     }
-}
\ No newline at end of file
+}
+
+
+// Bidirectional A* with average potentials: the forward search uses
+// (h_end(v) - h_start(v)) / 2 and the backward search its negation, so one
+// reduced edge cost serves both directions and they can stop together. Both
+// are shifted by half the start-end bound to stay non-negative, which the
+// monotone queues require. The side with the shorter open list is expanded
+// next, each touch of the other side's nodes proposes a route, and the search
+// stops once the last keys popped on both sides prove no shorter one is left.
+template <typename Queue>
+void BasicRoutePlanner<Queue>::BidirectionalSearch() {
+    Workspace_t &forward = m_Workspace;
+    Workspace_t &backward = m_Workspace.Reverse();
+    forward.Reset(this->NodeCount());
+    backward.Reset(this->NodeCount());
+
+    float span = this->LowerBound(start_node, end_node);
+    auto potential = [&](int node, bool is_forward) {
+        float difference = this->LowerBound(node, end_node) - this->LowerBound(node, start_node);
+        return 0.5f * ((is_forward ? difference : -difference) + span);
+    };
+    auto open = [](Workspace_t &side, int node, int parent, float g_value, float h_value) {
+        side.Visit(node);
+        side.Parent(node) = parent;
+        side.GValue(node) = g_value;
+        side.HValue(node) = h_value;
+        side.Open().Push(node, g_value + h_value);
+    };
+
+    int start = start_node, end = end_node;
+    open(forward, start, -1, 0.0f, potential(start, true));
+    open(backward, end, -1, 0.0f, potential(end, false));
+    float last_forward = forward.HValue(start), last_backward = backward.HValue(end);
+    float best = start == end ? 0.0f : std::numeric_limits<float>::max();
+    int meet_forward = start == end ? start : -1, meet_backward = meet_forward;
+
+    while (!forward.Open().Empty() && !backward.Open().Empty() && last_forward + last_backward < best + span) {
+        bool is_forward = forward.Open().Size() <= backward.Open().Size();
+        Workspace_t &side = is_forward ? forward : backward;
+        Workspace_t &other = is_forward ? backward : forward;
+        int current = side.Open().Pop();
+        ++this->settled;
+        (is_forward ? last_forward : last_backward) = side.GValue(current) + side.HValue(current);
+
+        this->ForEachEdge(current, [&](int target, float length) {
+            float g_value = side.GValue(current) + length;
+            if (other.Visited(target) && g_value + other.GValue(target) < best) {
+                best = g_value + other.GValue(target);
+                meet_forward = is_forward ? current : target;
+                meet_backward = is_forward ? target : current;
+            }
+            if (!side.Visited(target)) {
+                open(side, target, current, g_value, potential(target, is_forward));
+            }
+            else if (!side.Closed(target) && g_value < side.GValue(target)) {
+                side.Parent(target) = current;
+                side.GValue(target) = g_value;
+                side.Open().DecreaseKey(target, g_value + side.HValue(target));
+            }
+        });
+    }
+    if (meet_forward < 0)
+        return;
+
+    // Forward half from the start, then the backward tree's parents to the end.
+    this->path = this->ConstructFinalPath(meet_forward);
+    float tail = 0.0f;
+    int previous = meet_forward;
+    for (int node = meet_backward == meet_forward ? -1 : meet_backward; node >= 0; node = backward.Parent(node)) {
+        this->path.emplace_back(this->Position(node));
+        tail += this->Distance(previous, node);
+        previous = node;
+    }
+    this->distance += tail * m_Model.MetricScale();
+}
+
+
+template class BasicRoutePlanner<IndexedHeap>;
+template class BasicRoutePlanner<PairingHeap>;
+template class BasicRoutePlanner<RadixHeap>;
+template class BasicRoutePlanner<BucketQueue>;
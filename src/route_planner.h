@@ -4,30 +4,97 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include "landmarks.h"
 #include "route_model.h"
+#include "search_workspace.h"
 
 
-class RoutePlanner {
+// One route query on a shared, read-only RouteModel. The search state lives in
+// a workspace: either the planner's own, or one passed in so that a thread can
+// reuse its allocation across queries. Queue is the open list implementation,
+// see indexed_heap.h and priority_queues.h; the definitions are instantiated
+// for each of them in route_planner.cpp.
+template <typename Queue>
+class BasicRoutePlanner {
   public:
-    RoutePlanner(RouteModel &model, float start_x, float start_y, float end_x, float end_y);
+    using Workspace_t = BasicSearchWorkspace<Queue>;
+
+    // Forward searches from the start node only. Bidirectional also searches
+    // back from the end node, with average potentials so that both halves stay
+    // consistent, and usually settles about half as many nodes on long routes.
+    enum class SearchMode { Forward, Bidirectional };
+
+    // Node snaps the start and end points to the closest road nodes. Edge
+    // projects them onto the closest road segments instead, and the search
+    // starts and ends at virtual nodes there, numbered after the model's nodes
+    // and joined to the ends of their segments for this query only.
+    enum class Snap { Node, Edge };
+    using SnapScope = RouteModel::SnapScope;
+
+    // With SnapScope::LargestComponent, both points snap into the largest
+    // connected component, so that a route is found between any two of them.
+    BasicRoutePlanner(const RouteModel &model, float start_x, float start_y, float end_x, float end_y,
+                      Snap snap = Snap::Node, SnapScope scope = SnapScope::AnyComponent);
+    BasicRoutePlanner(const RouteModel &model, Workspace_t &workspace,
+                      float start_x, float start_y, float end_x, float end_y, Snap snap = Snap::Node,
+                      SnapScope scope = SnapScope::AnyComponent);
+    BasicRoutePlanner(const BasicRoutePlanner &) = delete;
+    BasicRoutePlanner &operator=(const BasicRoutePlanner &) = delete;
+
     // Add public variables or methods declarations here.
     float GetDistance() const {return distance;}
-    void AStarSearch();
+    // The nodes of the route found by AStarSearch, empty if there is none. When
+    // the start and end lie in different components, that is known up front
+    // and no node is settled.
+    const std::vector<Model::Node> &GetPath() const {return path;}
+    // Nodes taken off the open lists by the last search.
+    size_t GetSettledCount() const {return settled;}
+    void AStarSearch(SearchMode mode = SearchMode::Forward);
+    // Tightens the straight-line heuristic with ALT bounds from the given
+    // landmarks, built on the model's Graph(); nullptr goes back to straight lines.
+    void SetLandmarks(const Landmarks *landmarks) {m_Landmarks = landmarks;}
 
     // The following methods have been made public so we can test them individually.
-    void AddNeighbors(RouteModel::Node *current_node);
-    float CalculateHValue(RouteModel::Node const *node);
-    std::vector<RouteModel::Node> ConstructFinalPath(RouteModel::Node *);
-    RouteModel::Node *NextNode();
+    // Nodes are numbered as in the model, the virtual ones after them.
+    void AddNeighbors(int current_node);
+    float CalculateHValue(int node) const;
+    std::vector<Model::Node> ConstructFinalPath(int current_node);
+    int NextNode();
+    Workspace_t &Workspace() {return m_Workspace;}
 
   private:
     // Add private variables or methods declarations here.
-    std::vector<RouteModel::Node*> open_list;
-    RouteModel::Node *start_node;
-    RouteModel::Node *end_node;
+    void Open(int node, int parent, float g_value);
+    void BidirectionalSearch();
+    float LowerBound(int node, int target) const;
+    float LandmarkBound(int node, int target) const;
+    // Model nodes, then the virtual ones.
+    int NodeCount() const {return (int)m_Model.Nodes().size() + m_VirtualCount;}
+    Model::Node Position(int index) const;
+    float Distance(int a, int b) const {return RouteModel::Distance(Position(a), Position(b));}
+    int Component(int index) const;
+    template <typename F>
+    void ForEachEdge(int node, F f) const;
+
+    int start_node;
+    int end_node;
 
     float distance = 0.0f;
-    RouteModel &m_Model;
+    size_t settled = 0;
+    std::vector<Model::Node> path;
+    const RouteModel &m_Model;
+    const Landmarks *m_Landmarks = nullptr;
+    // Virtual start and end nodes and where they lie, with Snap::Edge.
+    int m_VirtualCount = 0;
+    Model::Node m_Virtual[2];
+    EdgePoint m_Snapped[2];
+    Workspace_t m_OwnWorkspace;
+    Workspace_t &m_Workspace;
 };
 
-#endif
\ No newline at end of file
+using RoutePlanner = BasicRoutePlanner<IndexedHeap>;
+using PairingHeapRoutePlanner = BasicRoutePlanner<PairingHeap>;
+using RadixHeapRoutePlanner = BasicRoutePlanner<RadixHeap>;
+using BucketQueueRoutePlanner = BasicRoutePlanner<BucketQueue>;
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SEARCH_WORKSPACE_H
+#define SEARCH_WORKSPACE_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "indexed_heap.h"
+#include "priority_queues.h"
+
+// Per-query search state over a graph, kept apart from the shared immutable
+// RouteModel so that any number of queries can run on one model, each thread
+// with its own workspace. State lives in flat arrays indexed by node number.
+// A node's entry counts only if its stamp matches the current generation, so
+// Reset() is O(1) and a query only ever writes the nodes it touches. The open
+// list is a Queue such as IndexedHeap; a visited node that has left it is closed.
+template <typename Queue>
+class BasicSearchWorkspace {
+  public:
+    // Starts a new query on a graph with node_count nodes.
+    void Reset(int node_count) {
+        if ((size_t)node_count != m_Stamp.size() || ++m_Generation == 0) {
+            m_Stamp.assign(node_count, 0);
+            m_G.resize(node_count);
+            m_H.resize(node_count);
+            m_Parent.resize(node_count);
+            m_Generation = 1;
+        }
+        m_Open.Reset(node_count);
+    }
+
+    // Whether the node has been reached by the current query.
+    bool Visited(int node) const { return m_Stamp[node] == m_Generation; }
+    // Whether the node has been reached and already expanded.
+    bool Closed(int node) const { return Visited(node) && !m_Open.Contains(node); }
+    // Marks the node reached, with no parent and an infinite g value.
+    void Visit(int node) {
+        m_Stamp[node] = m_Generation;
+        m_G[node] = std::numeric_limits<float>::max();
+        m_H[node] = std::numeric_limits<float>::max();
+        m_Parent[node] = -1;
+    }
+
+    // Only meaningful for visited nodes.
+    float &GValue(int node) { return m_G[node]; }
+    float GValue(int node) const { return m_G[node]; }
+    float &HValue(int node) { return m_H[node]; }
+    float HValue(int node) const { return m_H[node]; }
+    int &Parent(int node) { return m_Parent[node]; }
+    int Parent(int node) const { return m_Parent[node]; }
+
+    // Open list keyed by g + h.
+    Queue &Open() { return m_Open; }
+    const Queue &Open() const { return m_Open; }
+
+    // State of the backward half of a bidirectional query, made on first use.
+    BasicSearchWorkspace &Reverse() {
+        if (!m_Reverse)
+            m_Reverse = std::make_unique<BasicSearchWorkspace>();
+        return *m_Reverse;
+    }
+
+  private:
+    std::uint32_t m_Generation = 0;
+    std::vector<std::uint32_t> m_Stamp;
+    std::vector<float> m_G;
+    std::vector<float> m_H;
+    std::vector<int> m_Parent;
+    Queue m_Open;
+    std::unique_ptr<BasicSearchWorkspace> m_Reverse;
+};
+
+using SearchWorkspace = BasicSearchWorkspace<IndexedHeap>;
+
+#endif
@@ -0,0 +1,148 @@
+#include "segment_grid.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "snapshot_io.h"
+
+SegmentGrid::SegmentGrid(const Model &model, const RouteGraph &graph) {
+    auto &nodes = model.Nodes();
+    for (int from = 0; from < graph.NodeCount(); ++from)
+        for (int to : graph.Targets(from))
+            if (from < to)
+                m_Segments.push_back({(float)nodes.X(from), (float)nodes.Y(from), (float)nodes.X(to),
+                                      (float)nodes.Y(to), from, to});
+    if (m_Segments.empty())
+        return;
+
+    float max_x = m_Segments[0].ax, max_y = m_Segments[0].ay;
+    m_MinX = max_x;
+    m_MinY = max_y;
+    for (const Segment &segment : m_Segments) {
+        m_MinX = std::min({m_MinX, segment.ax, segment.bx});
+        m_MinY = std::min({m_MinY, segment.ay, segment.by});
+        max_x = std::max({max_x, segment.ax, segment.bx});
+        max_y = std::max({max_y, segment.ay, segment.by});
+    }
+    // About one cell per segment, and at most 1024 cells along either side.
+    float width = max_x - m_MinX, height = max_y - m_MinY;
+    m_CellSize = std::max({std::sqrt(width * height / m_Segments.size()), std::max(width, height) / 1024.0f, 1e-6f});
+    m_Columns = (int)(width / m_CellSize) + 1;
+    m_Rows = (int)(height / m_CellSize) + 1;
+
+    // Counts the segments of each cell, then fills them in.
+    auto for_each_cell = [this](const Segment &segment, auto f) {
+        int column_end = std::clamp(this->Column(std::max(segment.ax, segment.bx)), 0, m_Columns - 1);
+        int row_end = std::clamp(this->Row(std::max(segment.ay, segment.by)), 0, m_Rows - 1);
+        for (int row = std::clamp(this->Row(std::min(segment.ay, segment.by)), 0, m_Rows - 1); row <= row_end; ++row)
+            for (int column = std::clamp(this->Column(std::min(segment.ax, segment.bx)), 0, m_Columns - 1);
+                 column <= column_end; ++column)
+                f(row * m_Columns + column);
+    };
+    m_CellOffsets.assign((size_t)m_Columns * m_Rows + 1, 0);
+    for (const Segment &segment : m_Segments)
+        for_each_cell(segment, [this](int cell) { ++m_CellOffsets[cell + 1]; });
+    for (size_t i = 1; i < m_CellOffsets.size(); ++i)
+        m_CellOffsets[i] += m_CellOffsets[i - 1];
+    m_CellSegments.resize(m_CellOffsets.back());
+    std::vector<std::uint32_t> next(m_CellOffsets.begin(), m_CellOffsets.end() - 1);
+    for (size_t i = 0; i < m_Segments.size(); ++i)
+        for_each_cell(m_Segments[i], [&](int cell) { m_CellSegments[next[cell]++] = (int)i; });
+}
+
+
+// The scalars are widened to 8 bytes each, keeping the sections after them
+// aligned as the snapshot framing expects.
+SegmentGrid::SegmentGrid(SnapshotReader &reader, int node_count) {
+    m_MinX = (float)reader.Get<double>();
+    m_MinY = (float)reader.Get<double>();
+    m_CellSize = (float)reader.Get<double>();
+    auto columns = reader.Get<std::uint64_t>(), rows = reader.Get<std::uint64_t>();
+    if (columns > kMaxCells || rows > kMaxCells)
+        throw std::logic_error("snapshot is corrupted");
+    m_Columns = (int)columns;
+    m_Rows = (int)rows;
+    reader.GetArray(m_Segments);
+    reader.GetArray(m_CellOffsets);
+    reader.GetArray(m_CellSegments);
+    if (!(m_CellSize > 0.0f) || m_Segments.empty() != ((size_t)m_Columns * m_Rows == 0))
+        throw std::logic_error("snapshot is corrupted");
+    CheckSnapshotOffsets(m_CellOffsets, (size_t)m_Columns * m_Rows, m_CellSegments.size());
+    CheckSnapshotIndices(m_CellSegments, m_Segments.size());
+    for (const Segment &segment : m_Segments)
+        if (segment.from < 0 || segment.from >= node_count || segment.to < 0 || segment.to >= node_count)
+            throw std::logic_error("snapshot is corrupted");
+}
+
+
+void SegmentGrid::Save(SnapshotWriter &writer) const {
+    writer.Put<double>(m_MinX);
+    writer.Put<double>(m_MinY);
+    writer.Put<double>(m_CellSize);
+    writer.Put<std::uint64_t>(m_Columns);
+    writer.Put<std::uint64_t>(m_Rows);
+    writer.PutArray(m_Segments);
+    writer.PutArray(m_CellOffsets);
+    writer.PutArray(m_CellSegments);
+}
+
+
+// Cell coordinates of a point, clamped to one cell outside the grid.
+int SegmentGrid::Column(float x) const {
+    return (int)std::clamp(std::floor((x - m_MinX) / m_CellSize), -1.0f, (float)m_Columns);
+}
+
+int SegmentGrid::Row(float y) const {
+    return (int)std::clamp(std::floor((y - m_MinY) / m_CellSize), -1.0f, (float)m_Rows);
+}
+
+
+// Visits rings of cells around the point's cell, and stops once the closest
+// segment so far is nearer than any cell outside the rings can be.
+EdgePoint SegmentGrid::Nearest(float x, float y, Span<const int> labels, int label) const {
+    EdgePoint best;
+    if (m_Segments.empty())
+        return best;
+    int column = this->Column(x), row = this->Row(y);
+    auto visit = [&](int cell_column, int cell_row) {
+        if (cell_column < 0 || cell_column >= m_Columns || cell_row < 0 || cell_row >= m_Rows)
+            return;
+        int cell = cell_row * m_Columns + cell_column;
+        for (std::uint32_t i = m_CellOffsets[cell]; i < m_CellOffsets[cell + 1]; ++i) {
+            const Segment &segment = m_Segments[m_CellSegments[i]];
+            if (!labels.empty() && labels[segment.from] != label)
+                continue;
+            float dx = segment.bx - segment.ax, dy = segment.by - segment.ay;
+            float length = dx * dx + dy * dy;
+            float fraction = length > 0.0f ? ((x - segment.ax) * dx + (y - segment.ay) * dy) / length : 0.0f;
+            fraction = std::clamp(fraction, 0.0f, 1.0f);
+            float px = segment.ax + fraction * dx, py = segment.ay + fraction * dy;
+            float distance = std::hypot(x - px, y - py);
+            if (distance < best.distance)
+                best = {segment.from, segment.to, fraction, px, py, distance};
+        }
+    };
+
+    for (int ring = 0;; ++ring) {
+        if (ring == 0) {
+            visit(column, row);
+        }
+        else {
+            for (int c = column - ring; c <= column + ring; ++c) {
+                visit(c, row - ring);
+                visit(c, row + ring);
+            }
+            for (int r = row - ring + 1; r < row + ring; ++r) {
+                visit(column - ring, r);
+                visit(column + ring, r);
+            }
+        }
+        bool covers_grid = column - ring <= 0 && column + ring >= m_Columns - 1 && row - ring <= 0 &&
+                           row + ring >= m_Rows - 1;
+        float reach = std::min({x - (m_MinX + (column - ring) * m_CellSize),
+                                m_MinX + (column + ring + 1) * m_CellSize - x,
+                                y - (m_MinY + (row - ring) * m_CellSize),
+                                m_MinY + (row + ring + 1) * m_CellSize - y});
+        if (covers_grid || best.distance <= reach)
+            return best;
+    }
+}
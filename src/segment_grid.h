@@ -0,0 +1,74 @@
+#ifndef SEGMENT_GRID_H
+#define SEGMENT_GRID_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "model.h"
+#include "route_graph.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// A point on the road segment between nodes from and to, the given fraction
+// of the way from from, at the given distance from the point it was snapped from.
+struct EdgePoint {
+    int from = -1;
+    int to = -1;
+    float fraction = 0.0f;
+    float x = 0.0f;
+    float y = 0.0f;
+    float distance = std::numeric_limits<float>::max();
+};
+
+// Uniform grid over the segments of a RouteGraph, one undirected segment per
+// edge, for snapping points onto the road network. Cells are sized from the
+// bounds so that there is about one cell per segment, and a segment is listed
+// in every cell its bounding box touches, in compressed sparse row form.
+class SegmentGrid {
+  public:
+    SegmentGrid() = default;
+    SegmentGrid(const Model &model, const RouteGraph &graph);
+    // Reads back what Save() wrote for a grid over nodes below node_count.
+    SegmentGrid(SnapshotReader &reader, int node_count);
+    void Save(SnapshotWriter &writer) const;
+
+    size_t SegmentCount() const { return m_Segments.size(); }
+
+    // Projection of (x, y) onto the closest segment; from is -1 if there are none.
+    // With labels, only segments whose ends are labelled label count.
+    EdgePoint Nearest(float x, float y, Span<const int> labels = {}, int label = 0) const;
+
+    size_t Bytes() const {
+        return m_Segments.capacity() * sizeof(Segment) + m_CellOffsets.capacity() * sizeof(std::uint32_t) +
+               m_CellSegments.capacity() * sizeof(int);
+    }
+
+  private:
+    struct Segment {
+        float ax;
+        float ay;
+        float bx;
+        float by;
+        int from;
+        int to;
+    };
+
+    // Columns or rows a grid can have: 1024 cells of the smallest size span the
+    // bounds, and one more absorbs rounding.
+    static constexpr std::uint64_t kMaxCells = 1025;
+
+    int Column(float x) const;
+    int Row(float y) const;
+
+    float m_MinX = 0.0f;
+    float m_MinY = 0.0f;
+    float m_CellSize = 1.0f;
+    int m_Columns = 0;
+    int m_Rows = 0;
+    std::vector<Segment> m_Segments;
+    std::vector<std::uint32_t> m_CellOffsets{0};
+    std::vector<int> m_CellSegments;
+};
+
+#endif
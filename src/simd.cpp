@@ -0,0 +1,22 @@
+#include "simd.h"
+
+bool IsSupported( SimdLevel level ) noexcept
+{
+#if OSM_SIMD_X86
+    switch( level ) {
+        case SimdLevel::Scalar: return true;
+        case SimdLevel::SSE2:   return __builtin_cpu_supports("sse2");
+        case SimdLevel::AVX2:   return __builtin_cpu_supports("avx2");
+    }
+    return false;
+#else
+    return level == SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel BestSimdLevel() noexcept
+{
+    static const auto best = IsSupported(SimdLevel::AVX2) ? SimdLevel::AVX2 :
+                              IsSupported(SimdLevel::SSE2) ? SimdLevel::SSE2 : SimdLevel::Scalar;
+    return best;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// Instruction sets the batch kernels are compiled for. BestSimdLevel() picks the
+// widest one the running CPU supports.
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+SimdLevel BestSimdLevel() noexcept;
+bool IsSupported( SimdLevel level ) noexcept;
+
+// x86 kernels are compiled per function with target attributes and selected at
+// runtime, so the binary still runs on CPUs without AVX2.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define OSM_SIMD_X86 1
+    #define OSM_TARGET_SSE2 __attribute__((target("sse2")))
+    #define OSM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define OSM_SIMD_X86 0
+    #define OSM_TARGET_SSE2
+    #define OSM_TARGET_AVX2
+#endif
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "span.h"
+
+// Framing shared by the files written during preprocessing: a fixed header
+// followed by a payload of sections, each array prefixed by its element count
+// and padded to 8 bytes. Integers are stored in native byte order, the byte
+// order mark rejects files from foreign machines, and a checksum over the
+// payload catches truncation and corruption.
+
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t payload_size;
+    std::uint64_t checksum;
+};
+
+constexpr std::uint32_t kSnapshotByteOrderMark = 0x01020304;
+
+// FNV-1a over 64-bit words, with the trailing bytes folded in one at a time.
+inline std::uint64_t Checksum(const std::byte *data, std::size_t size) noexcept
+{
+    const std::uint64_t prime = 0x100000001b3ull;
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    std::size_t i = 0;
+    for( ; i + 8 <= size; i += 8 ) {
+        std::uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for( ; i < size; ++i )
+        hash = (hash ^ (std::uint64_t)data[i]) * prime;
+    return hash;
+}
+
+class SnapshotWriter
+{
+public:
+    template <typename T>
+    void Put(const T &value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_Buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void PutArray(const T *data, std::size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Put<std::uint64_t>(count);
+        m_Buffer.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+        m_Buffer.resize((m_Buffer.size() + 7) / 8 * 8, '\0');
+    }
+
+    template <typename T>
+    void PutArray(const std::vector<T> &values) { PutArray(values.data(), values.size()); }
+
+    const std::string &Buffer() const noexcept { return m_Buffer; }
+
+private:
+    std::string m_Buffer;
+};
+
+class SnapshotReader
+{
+public:
+    SnapshotReader(const std::byte *begin, const std::byte *end) noexcept: m_Cur(begin), m_End(end) {}
+
+    template <typename T>
+    T Get() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Require(sizeof(T));
+        T value;
+        memcpy(&value, m_Cur, sizeof(T));
+        m_Cur += sizeof(T);
+        return value;
+    }
+
+    template <typename T>
+    void GetArray(std::vector<T> &values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto count = Get<std::uint64_t>();
+        if( count > (std::uint64_t)(m_End - m_Cur) / sizeof(T) )
+            throw std::logic_error("snapshot is truncated");
+        values.resize(count);
+        if( count )
+            memcpy(values.data(), m_Cur, count * sizeof(T));
+        m_Cur += (count * sizeof(T) + 7) / 8 * 8;
+        if( m_Cur > m_End )
+            throw std::logic_error("snapshot is truncated");
+    }
+
+    // The bytes not read yet.
+    Span<const std::byte> Remaining() const noexcept { return {m_Cur, (std::size_t)(m_End - m_Cur)}; }
+
+private:
+    void Require(std::size_t size) const {
+        if( size > (std::size_t)(m_End - m_Cur) )
+            throw std::logic_error("snapshot is truncated");
+    }
+
+    const std::byte *m_Cur;
+    const std::byte *m_End;
+};
+
+// Checks on arrays read back from a snapshot whose checksum matched but whose
+// writer may still have been wrong, so that indices cannot point out of range.
+// Offsets into a compressed sparse row array must run from 0 up to its size
+// without going down, count + 1 of them.
+inline void CheckSnapshotOffsets( const std::vector<std::uint32_t> &offsets, std::size_t count, std::size_t size )
+{
+    if( offsets.size() != count + 1 || offsets.front() != 0 || offsets.back() != size )
+        throw std::logic_error("snapshot is corrupted");
+    for( std::size_t i = 1; i < offsets.size(); ++i )
+        if( offsets[i] < offsets[i - 1] )
+            throw std::logic_error("snapshot is corrupted");
+}
+
+inline void CheckSnapshotIndices( const std::vector<int> &indices, std::size_t size )
+{
+    for( auto index: indices )
+        if( index < 0 || (std::size_t)index >= size )
+            throw std::logic_error("snapshot is corrupted");
+}
+
+inline bool HasSnapshotMagic( Span<const std::byte> data, const char (&magic)[8] ) noexcept
+{
+    return data.size() >= sizeof(SnapshotHeader) && memcmp(data.data(), magic, sizeof(magic)) == 0;
+}
+
+inline void WriteSnapshotFile( std::ostream &os, const char (&magic)[8], std::uint32_t version, const std::string &payload )
+{
+    SnapshotHeader header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byte_order = kSnapshotByteOrderMark;
+    header.payload_size = payload.size();
+    header.checksum = Checksum(reinterpret_cast<const std::byte*>(payload.data()), payload.size());
+
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(payload.data(), payload.size());
+    if( !os )
+        throw std::runtime_error("failed to write the snapshot");
+}
+
+// Checks the header and checksum, and returns a reader over the payload.
+inline SnapshotReader ReadSnapshotFile( Span<const std::byte> data, const char (&magic)[8], std::uint32_t version )
+{
+    if( !HasSnapshotMagic(data, magic) )
+        throw std::logic_error("not a snapshot of the expected kind");
+    SnapshotHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    if( header.byte_order != kSnapshotByteOrderMark )
+        throw std::logic_error("snapshot was written with a different byte order");
+    if( header.version != version )
+        throw std::logic_error("unsupported snapshot version " + std::to_string(header.version));
+
+    auto payload = data.data() + sizeof(header);
+    if( header.payload_size != data.size() - sizeof(header) )
+        throw std::logic_error("snapshot is truncated");
+    if( Checksum(payload, header.payload_size) != header.checksum )
+        throw std::logic_error("snapshot checksum mismatch");
+    return SnapshotReader{payload, payload + header.payload_size};
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+// Non-owning view over a contiguous range, a small stand-in for C++20 std::span.
+template <typename T>
+class Span
+{
+public:
+    using value_type = std::remove_cv_t<T>;
+    using iterator = T*;
+
+    Span() noexcept = default;
+    Span( T *data, std::size_t size ) noexcept : m_Data(data), m_Size(size) {}
+
+    // Any container exposing data() and size(), e.g. std::vector.
+    template <typename Container,
+              typename = std::enable_if_t<std::is_convertible_v<decltype(std::declval<Container&>().data()), T*>>>
+    Span( Container &container ) noexcept : m_Data(container.data()), m_Size(container.size()) {}
+
+    T *data() const noexcept { return m_Data; }
+    std::size_t size() const noexcept { return m_Size; }
+    bool empty() const noexcept { return m_Size == 0; }
+
+    T *begin() const noexcept { return m_Data; }
+    T *end() const noexcept { return m_Data + m_Size; }
+    std::reverse_iterator<T*> rbegin() const noexcept { return std::reverse_iterator<T*>{end()}; }
+    std::reverse_iterator<T*> rend() const noexcept { return std::reverse_iterator<T*>{begin()}; }
+    T &front() const noexcept { return m_Data[0]; }
+    T &back() const noexcept { return m_Data[m_Size - 1]; }
+    T &operator[]( std::size_t i ) const noexcept { return m_Data[i]; }
+
+private:
+    T *m_Data = nullptr;
+    std::size_t m_Size = 0;
+};
@@ -0,0 +1,46 @@
+#include "way_store.h"
+#include <stdexcept>
+
+int WayStore::Add( Span<const int> nodes )
+{
+    m_Nodes.insert(m_Nodes.end(), nodes.begin(), nodes.end());
+    m_Offsets.emplace_back((std::uint32_t)m_Nodes.size());
+    return (int)size() - 1;
+}
+
+void WayStore::Append( const WayStore &other )
+{
+    const auto base = (std::uint32_t)m_Nodes.size();
+    m_Nodes.insert(m_Nodes.end(), other.m_Nodes.begin(), other.m_Nodes.end());
+    for( auto it = other.m_Offsets.begin() + 1; it != other.m_Offsets.end(); ++it )
+        m_Offsets.emplace_back(base + *it);
+}
+
+void WayStore::Reserve( std::size_t ways, std::size_t nodes )
+{
+    m_Offsets.reserve(ways + 1);
+    m_Nodes.reserve(nodes);
+}
+
+void WayStore::Clear() noexcept
+{
+    m_Offsets.resize(1);
+    m_Nodes.clear();
+}
+
+void WayStore::ShrinkToFit()
+{
+    m_Offsets.shrink_to_fit();
+    m_Nodes.shrink_to_fit();
+}
+
+void WayStore::Assign( std::vector<std::uint32_t> offsets, std::vector<int> nodes )
+{
+    if( offsets.empty() || offsets.front() != 0 || offsets.back() != nodes.size() )
+        throw std::logic_error("inconsistent way offsets");
+    for( std::size_t i = 1; i < offsets.size(); ++i )
+        if( offsets[i] < offsets[i - 1] )
+            throw std::logic_error("inconsistent way offsets");
+    m_Offsets = std::move(offsets);
+    m_Nodes = std::move(nodes);
+}
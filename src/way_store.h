@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "span.h"
+#include "index_iterator.h"
+
+struct WayView {
+    Span<const int> nodes;
+};
+
+// Node lists of all ways in compressed sparse row form: way i holds the node
+// numbers in [offsets[i], offsets[i + 1]) of one shared array. Ways are only
+// ever appended, and views stay valid until the next append.
+class WayStore
+{
+public:
+    using const_iterator = IndexIterator<WayStore>;
+
+    std::size_t size() const noexcept { return m_Offsets.size() - 1; }
+    bool empty() const noexcept { return m_Offsets.size() == 1; }
+    const_iterator begin() const noexcept { return {this, 0}; }
+    const_iterator end() const noexcept { return {this, size()}; }
+    WayView operator[]( std::size_t i ) const noexcept {
+        return {{m_Nodes.data() + m_Offsets[i], m_Offsets[i + 1] - m_Offsets[i]}};
+    }
+
+    // Appends a way and returns its number.
+    int Add( Span<const int> nodes );
+    // Appends all ways of another store, in order.
+    void Append( const WayStore &other );
+    void Reserve( std::size_t ways, std::size_t nodes );
+    void Clear() noexcept;
+    void ShrinkToFit();
+
+    // The raw CSR arrays, e.g. for snapshots or renumbering nodes in place.
+    Span<const std::uint32_t> Offsets() const noexcept { return m_Offsets; }
+    Span<const int> NodeNumbers() const noexcept { return m_Nodes; }
+    Span<int> NodeNumbers() noexcept { return m_Nodes; }
+    // Replaces the contents with CSR arrays, throws std::logic_error if they are inconsistent.
+    void Assign( std::vector<std::uint32_t> offsets, std::vector<int> nodes );
+
+    std::size_t Bytes() const noexcept {
+        return m_Offsets.capacity() * sizeof(std::uint32_t) + m_Nodes.capacity() * sizeof(int);
+    }
+
+private:
+    std::vector<std::uint32_t> m_Offsets{0};
+    std::vector<int> m_Nodes;
+};
@@ -0,0 +1,145 @@
+#include "xml_reader.h"
+#include <cstring>
+#include <stdexcept>
+
+static bool IsSpace(char c) noexcept
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool IsNameEnd(char c) noexcept
+{
+    return IsSpace(c) || c == '/' || c == '>' || c == '=';
+}
+
+XmlReader::XmlReader( const char *begin, const char *end ) noexcept:
+    m_Cur(begin),
+    m_End(end)
+{
+}
+
+std::string_view XmlReader::Attribute( std::string_view name ) const noexcept
+{
+    for( auto &attribute: m_Attributes )
+        if( attribute.first == name )
+            return attribute.second;
+    return {};
+}
+
+void XmlReader::SkipPast( std::string_view terminator )
+{
+    std::string_view rest{m_Cur, (size_t)(m_End - m_Cur)};
+    auto pos = rest.find(terminator);
+    if( pos == std::string_view::npos )
+        throw std::logic_error("failed to parse the xml file");
+    m_Cur += pos + terminator.size();
+}
+
+bool XmlReader::Next()
+{
+    while( true ) {
+        auto open = (const char*)memchr(m_Cur, '<', m_End - m_Cur);
+        if( !open ) {
+            if( m_OpenElements != 0 )
+                throw std::logic_error("failed to parse the xml file");
+            return false;
+        }
+        m_Cur = open + 1;
+        if( m_Cur == m_End )
+            throw std::logic_error("failed to parse the xml file");
+
+        if( *m_Cur == '?' ) {
+            SkipPast("?>");
+        }
+        else if( *m_Cur == '!' ) {
+            std::string_view rest{m_Cur, (size_t)(m_End - m_Cur)};
+            if( rest.substr(0, 3) == "!--" )
+                SkipPast("-->");
+            else if( rest.substr(0, 8) == "![CDATA[" )
+                SkipPast("]]>");
+            else
+                SkipPast(">");
+        }
+        else if( *m_Cur == '/' ) {
+            ++m_Cur;
+            ParseEndTag();
+            return true;
+        }
+        else {
+            ParseStartTag();
+            return true;
+        }
+    }
+}
+
+void XmlReader::ParseStartTag()
+{
+    auto name_begin = m_Cur;
+    while( m_Cur < m_End && !IsNameEnd(*m_Cur) )
+        ++m_Cur;
+    if( m_Cur == name_begin )
+        throw std::logic_error("failed to parse the xml file");
+    m_Name = std::string_view{name_begin, (size_t)(m_Cur - name_begin)};
+    m_Attributes.clear();
+    m_IsEndTag = false;
+    m_IsEmptyElement = false;
+
+    while( true ) {
+        while( m_Cur < m_End && IsSpace(*m_Cur) )
+            ++m_Cur;
+        if( m_Cur == m_End )
+            throw std::logic_error("failed to parse the xml file");
+        if( *m_Cur == '>' ) {
+            ++m_Cur;
+            break;
+        }
+        if( *m_Cur == '/' ) {
+            if( m_Cur + 1 == m_End || m_Cur[1] != '>' )
+                throw std::logic_error("failed to parse the xml file");
+            m_Cur += 2;
+            m_IsEmptyElement = true;
+            break;
+        }
+
+        auto attr_begin = m_Cur;
+        while( m_Cur < m_End && !IsNameEnd(*m_Cur) )
+            ++m_Cur;
+        auto attr_name = std::string_view{attr_begin, (size_t)(m_Cur - attr_begin)};
+        while( m_Cur < m_End && IsSpace(*m_Cur) )
+            ++m_Cur;
+        if( attr_name.empty() || m_Cur == m_End || *m_Cur != '=' )
+            throw std::logic_error("failed to parse the xml file");
+        ++m_Cur;
+        while( m_Cur < m_End && IsSpace(*m_Cur) )
+            ++m_Cur;
+        if( m_Cur == m_End || (*m_Cur != '"' && *m_Cur != '\'') )
+            throw std::logic_error("failed to parse the xml file");
+        auto quote = *m_Cur++;
+        auto value_end = (const char*)memchr(m_Cur, quote, m_End - m_Cur);
+        if( !value_end )
+            throw std::logic_error("failed to parse the xml file");
+        m_Attributes.emplace_back(attr_name, std::string_view{m_Cur, (size_t)(value_end - m_Cur)});
+        m_Cur = value_end + 1;
+    }
+
+    m_Depth = m_OpenElements;
+    if( !m_IsEmptyElement )
+        ++m_OpenElements;
+}
+
+void XmlReader::ParseEndTag()
+{
+    auto name_begin = m_Cur;
+    while( m_Cur < m_End && !IsNameEnd(*m_Cur) )
+        ++m_Cur;
+    m_Name = std::string_view{name_begin, (size_t)(m_Cur - name_begin)};
+    while( m_Cur < m_End && IsSpace(*m_Cur) )
+        ++m_Cur;
+    if( m_Name.empty() || m_Cur == m_End || *m_Cur != '>' || m_OpenElements == 0 )
+        throw std::logic_error("failed to parse the xml file");
+    ++m_Cur;
+    m_Attributes.clear();
+    m_IsEndTag = true;
+    m_IsEmptyElement = false;
+    m_Depth = --m_OpenElements;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Forward-only pull reader over an in-memory XML buffer. It reports start and
+// end tags together with their raw attributes and never builds a tree, so the
+// only memory it touches beyond the input is a small reusable attribute list.
+// Text content, comments, processing instructions and DOCTYPE are skipped.
+// Attribute values are returned verbatim: entity references are not decoded,
+// which is fine for the ids, coordinates and tag keywords the loader compares.
+class XmlReader
+{
+public:
+    XmlReader( const char *begin, const char *end ) noexcept;
+
+    // Advances to the next start or end tag, returns false at the end of input.
+    // Throws std::logic_error on malformed markup.
+    bool Next();
+
+    std::string_view Name() const noexcept { return m_Name; }
+    bool IsEndTag() const noexcept { return m_IsEndTag; }
+    bool IsEmptyElement() const noexcept { return m_IsEmptyElement; }
+
+    // Nesting level of the current element, the document root has depth 0.
+    int Depth() const noexcept { return m_Depth; }
+
+    // Returns an empty view when the attribute is absent.
+    std::string_view Attribute( std::string_view name ) const noexcept;
+
+private:
+    void ParseStartTag();
+    void ParseEndTag();
+    void SkipPast( std::string_view terminator );
+
+    const char *m_Cur;
+    const char *m_End;
+    std::string_view m_Name;
+    std::vector<std::pair<std::string_view, std::string_view>> m_Attributes;
+    bool m_IsEndTag = false;
+    bool m_IsEmptyElement = false;
+    int m_OpenElements = 0;
+    int m_Depth = -1;
+};
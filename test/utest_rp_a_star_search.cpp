@@ -1,40 +1,535 @@
 #include "gtest/gtest.h"
-#include <fstream>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <queue>
+#include <random>
 #include <iostream>
-#include <optional>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <cstring>
 #include <vector>
+#include "../src/contraction_hierarchy.h"
+#include "../src/id_index.h"
+#include "../src/indexed_heap.h"
+#include "../src/landmarks.h"
+#include "../src/mapped_file.h"
+#include "../src/osm_parse.h"
 #include "../src/route_model.h"
 #include "../src/route_planner.h"
+#include "../src/snapshot_io.h"
 
 
-static std::optional<std::vector<std::byte>> ReadFile(const std::string &path)
-{   
-    std::ifstream is{path, std::ios::binary | std::ios::ate};
-    if( !is )
-        return std::nullopt;
-    
-    auto size = is.tellg();
-    std::vector<std::byte> contents(size);    
-    
-    is.seekg(0);
-    is.read((char*)contents.data(), size);
+MappedFile ReadOSMData(const std::string &path) {
+    auto data = MappedFile::Open(path);
+    if( !data ) {
+        std::cout << "Failed to read OSM data." << std::endl;
+        return {};
+    }
+    return std::move(*data);
+}
 
-    if( contents.empty() )
-        return std::nullopt;
-    return std::move(contents);
+//--------------------------------//
+//   Beginning Model Tests.
+//--------------------------------//
+
+static void ExpectSameMultipolygons(const Model::Multipolygon &a, const Model::Multipolygon &b) {
+    EXPECT_EQ(a.outer, b.outer);
+    EXPECT_EQ(a.inner, b.inner);
 }
 
-std::vector<std::byte> ReadOSMData(const std::string &path) {
-    std::vector<std::byte> osm_data;
-    auto data = ReadFile(path);
-    if( !data ) {
-        std::cout << "Failed to read OSM data." << std::endl;
-    } else {
-        osm_data = std::move(*data);
+static std::vector<int> WayNodes(const Model::Way &way) {
+    return {way.nodes.begin(), way.nodes.end()};
+}
+
+static void ExpectSameModel(const Model &a, const Model &b) {
+    EXPECT_DOUBLE_EQ(a.MetricScale(), b.MetricScale());
+    ASSERT_EQ(a.Nodes().size(), b.Nodes().size());
+    for (size_t i = 0; i < a.Nodes().size(); i++) {
+        EXPECT_DOUBLE_EQ(a.Nodes()[i].x, b.Nodes()[i].x);
+        EXPECT_DOUBLE_EQ(a.Nodes()[i].y, b.Nodes()[i].y);
+    }
+    ASSERT_EQ(a.Ways().size(), b.Ways().size());
+    for (size_t i = 0; i < a.Ways().size(); i++)
+        EXPECT_EQ(WayNodes(a.Ways()[i]), WayNodes(b.Ways()[i]));
+    ASSERT_EQ(a.Roads().size(), b.Roads().size());
+    for (size_t i = 0; i < a.Roads().size(); i++) {
+        EXPECT_EQ(a.Roads()[i].way, b.Roads()[i].way);
+        EXPECT_EQ(a.Roads()[i].type, b.Roads()[i].type);
     }
-    return osm_data;
+    ASSERT_EQ(a.Railways().size(), b.Railways().size());
+    for (size_t i = 0; i < a.Railways().size(); i++)
+        EXPECT_EQ(a.Railways()[i].way, b.Railways()[i].way);
+    ASSERT_EQ(a.Buildings().size(), b.Buildings().size());
+    for (size_t i = 0; i < a.Buildings().size(); i++)
+        ExpectSameMultipolygons(a.Buildings()[i], b.Buildings()[i]);
+    ASSERT_EQ(a.Leisures().size(), b.Leisures().size());
+    for (size_t i = 0; i < a.Leisures().size(); i++)
+        ExpectSameMultipolygons(a.Leisures()[i], b.Leisures()[i]);
+    ASSERT_EQ(a.Waters().size(), b.Waters().size());
+    for (size_t i = 0; i < a.Waters().size(); i++)
+        ExpectSameMultipolygons(a.Waters()[i], b.Waters()[i]);
+    ASSERT_EQ(a.Landuses().size(), b.Landuses().size());
+    for (size_t i = 0; i < a.Landuses().size(); i++) {
+        ExpectSameMultipolygons(a.Landuses()[i], b.Landuses()[i]);
+        EXPECT_EQ(a.Landuses()[i].type, b.Landuses()[i].type);
+    }
+}
+
+// The streaming loader must produce exactly the same model as the DOM loader.
+TEST(ModelTest, StreamingMatchesDOM) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    Model::LoadOptions dom_options;
+    dom_options.parser = Model::LoadOptions::Parser::DOM;
+    Model dom{osm_data, dom_options};
+    Model streaming{osm_data};
+    ExpectSameModel(dom, streaming);
+}
+
+// Parallel chunked parsing must number nodes and ways exactly like a single thread.
+TEST(ModelTest, ParallelMatchesStreaming) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    Model streaming{osm_data};
+    for (unsigned threads : {2u, 3u, 8u}) {
+        Model::LoadOptions options;
+        options.threads = threads;
+        Model parallel{osm_data, options};
+        ExpectSameModel(streaming, parallel);
+    }
+}
+
+// Files that are not ordered as nodes, ways, relations fall back to the sequential reader.
+TEST(ModelTest, ParallelHandlesUnorderedInput) {
+    std::string xml = R"(<?xml version="1.0" encoding="UTF-8"?>
+<osm version="0.6">
+ <bounds minlat="30.27" minlon="-97.75" maxlat="30.28" maxlon="-97.73"/>
+ <node id="1" lat="30.271" lon="-97.741"/>
+ <way id="10"><nd ref="1"/><nd ref="2"/><tag k="highway" v="residential"/></way>
+ <node id="2" lat="30.272" lon="-97.742"><tag k="name" v="late"/></node>
+ <way id="11"><nd ref="2"/><nd ref="1"/><tag k="highway" v="service"/></way>
+</osm>)";
+    std::vector<std::byte> osm_data(xml.size());
+    std::memcpy(osm_data.data(), xml.data(), xml.size());
+    Model streaming{osm_data};
+    Model::LoadOptions options;
+    options.threads = 4;
+    Model parallel{osm_data, options};
+    ExpectSameModel(streaming, parallel);
+    ASSERT_EQ(parallel.Ways().size(), 2);
+    EXPECT_EQ(WayNodes(parallel.Ways()[0]), std::vector<int>{0});
+    EXPECT_EQ(WayNodes(parallel.Ways()[1]), (std::vector<int>{1, 0}));
 }
 
+// Loading only the road layer must keep every road intact and drop everything else.
+TEST(ModelTest, RoutingOnlyLayers) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    Model full{osm_data};
+    Model::LoadOptions options;
+    options.layers = Model::LoadOptions::Roads;
+    Model routing{osm_data, options};
+
+    EXPECT_TRUE(routing.Railways().empty());
+    EXPECT_TRUE(routing.Buildings().empty());
+    EXPECT_TRUE(routing.Leisures().empty());
+    EXPECT_TRUE(routing.Waters().empty());
+    EXPECT_TRUE(routing.Landuses().empty());
+    EXPECT_EQ(routing.Ways().size(), routing.Roads().size());
+    EXPECT_LT(routing.Nodes().size(), full.Nodes().size());
+    EXPECT_EQ(routing.MetricScale(), full.MetricScale());
+
+    std::vector<bool> referenced(routing.Nodes().size());
+    ASSERT_EQ(routing.Roads().size(), full.Roads().size());
+    for (size_t i = 0; i < full.Roads().size(); ++i) {
+        EXPECT_EQ(routing.Roads()[i].type, full.Roads()[i].type);
+        auto a = full.Ways()[full.Roads()[i].way].nodes;
+        auto b = routing.Ways()[routing.Roads()[i].way].nodes;
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t j = 0; j < a.size(); ++j) {
+            // Fixed-point steps depend on the extent of the kept nodes.
+            EXPECT_NEAR(full.Nodes()[a[j]].x, routing.Nodes()[b[j]].x, 1e-9);
+            EXPECT_NEAR(full.Nodes()[a[j]].y, routing.Nodes()[b[j]].y, 1e-9);
+            referenced[b[j]] = true;
+        }
+    }
+    EXPECT_EQ(std::count(referenced.begin(), referenced.end(), false), 0);
+
+    options.parser = Model::LoadOptions::Parser::DOM;
+    ExpectSameModel(routing, Model{osm_data, options});
+    options.parser = Model::LoadOptions::Parser::Streaming;
+    options.threads = 3;
+    ExpectSameModel(routing, Model{osm_data, options});
+}
+
+// Open relation members are stitched into closed rings; broken relations must
+// neither stall nor produce rings that do not close.
+TEST(ModelTest, BuildRingsStitchesOpenWays) {
+    std::string xml = R"(<osm version="0.6">
+ <bounds minlat="30.27" minlon="-97.75" maxlat="30.28" maxlon="-97.73"/>
+)";
+    for (int id = 1; id <= 200; ++id)
+        xml += " <node id=\"" + std::to_string(id) + "\" lat=\"30.275\" lon=\"-97.74\"/>\n";
+    auto way = [&](int id, std::vector<int> refs) {
+        xml += " <way id=\"" + std::to_string(id) + "\">";
+        for (int ref : refs)
+            xml += "<nd ref=\"" + std::to_string(ref) + "\"/>";
+        xml += "</way>\n";
+    };
+    // A square 1-2-3-4 split into three pieces, one of them reversed.
+    way(1000, {1, 2});
+    way(1001, {4, 3, 2});
+    way(1002, {4, 1});
+    // A dangling way followed by a ladder of parallel detours between nodes
+    // 100, 101, ..., 130, which has exponentially many simple paths.
+    way(2000, {99, 100});
+    for (int i = 0; i < 30; ++i) {
+        way(2001 + 2 * i, {100 + i, 150 + i, 101 + i});
+        way(2002 + 2 * i, {101 + i, 170 + i, 100 + i});
+    }
+    xml += R"( <relation id="1">
+  <member type="way" ref="1000" role="outer"/>
+  <member type="way" ref="1001" role="outer"/>
+  <member type="way" ref="1002" role="outer"/>
+  <tag k="landuse" v="grass"/>
+ </relation>
+ <relation id="2">
+)";
+    for (int id = 2000; id <= 2060; ++id)
+        xml += "  <member type=\"way\" ref=\"" + std::to_string(id) + "\" role=\"outer\"/>\n";
+    xml += R"(  <tag k="natural" v="water"/>
+ </relation>
+</osm>)";
+    std::vector<std::byte> osm_data(xml.size());
+    std::memcpy(osm_data.data(), xml.data(), xml.size());
+    Model model{osm_data};
+
+    ASSERT_EQ(model.Landuses().size(), 1);
+    ASSERT_EQ(model.Landuses()[0].outer.size(), 1);
+    EXPECT_EQ(WayNodes(model.Ways()[model.Landuses()[0].outer[0]]), (std::vector<int>{0, 1, 1, 2, 3, 3, 0}));
+
+    ASSERT_EQ(model.Waters().size(), 1);
+    EXPECT_FALSE(model.Waters()[0].outer.empty());
+    for (int way_num : model.Waters()[0].outer) {
+        auto nodes = model.Ways()[way_num].nodes;
+        ASSERT_GT(nodes.size(), 1);
+        EXPECT_EQ(nodes.front(), nodes.back());
+    }
+}
+
+// Construction fills in phase timings and container sizes for every loader.
+TEST(ModelTest, LoadStats) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    for (auto parser : {Model::LoadOptions::Parser::Streaming, Model::LoadOptions::Parser::DOM}) {
+        Model::LoadOptions options;
+        options.parser = parser;
+        RouteModel model{osm_data, options};
+        auto &stats = model.Stats();
+        using Phase = LoadStats::Phase;
+        using Container = LoadStats::Container;
+        for (auto phase : {Phase::Nodes, Phase::Ways, Phase::Relations, Phase::AdjustCoordinates,
+                           Phase::NodeToRoad})
+            EXPECT_GT(stats.Seconds(phase), 0.) << LoadStats::Name(phase);
+        EXPECT_EQ(stats.Seconds(Phase::Snapshot), 0.);
+        EXPECT_EQ(stats.Memory(Container::Nodes).count, model.Nodes().size());
+        EXPECT_EQ(stats.Memory(Container::Ways).count, model.Ways().size());
+        EXPECT_EQ(stats.Memory(Container::Landuses).count, model.Landuses().size());
+        EXPECT_GE(stats.Memory(Container::Nodes).bytes, model.Nodes().size() * 2 * sizeof(NodeStore::Coordinate));
+        EXPECT_GT(stats.TotalBytes(), 0);
+
+        std::ostringstream json;
+        stats.WriteJson(json);
+        EXPECT_NE(json.str().find("\"node_to_road\": {\"count\": "), std::string::npos);
+        EXPECT_NE(json.str().find("\"total_seconds\": "), std::string::npos);
+    }
+}
+
+// Stored coordinates must read back within the resolution of the build's precision.
+TEST(ModelTest, NodeStorePrecision) {
+    std::vector<double> x{0.0, 0.25, 1.0, -0.5, 0.123456789}, y{3.0, 2.5, 0.1, 0.0, 1.987654321};
+    NodeStore store;
+    store.Assign(x.data(), y.data(), x.size());
+    ASSERT_EQ(store.size(), x.size());
+    const double tolerance = NodeStore::kFixedPoint ? 1e-9 : sizeof(NodeStore::Coordinate) == 4 ? 1e-6 : 0.;
+    size_t i = 0;
+    for (auto node : store) {
+        EXPECT_NEAR(node.x, x[i], tolerance);
+        EXPECT_NEAR(node.y, y[i], tolerance);
+        ++i;
+    }
+    EXPECT_EQ(i, x.size());
+    EXPECT_EQ(store.EncodedX().size(), x.size());
+}
+
+// Every batch projection kernel must agree with the std::log/std::tan reference to
+// well below a millimetre, over the map and over the whole Mercator latitude range.
+TEST(ModelTest, ProjectionKernelsMatchReference) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    Model model{osm_data};
+    const MercatorProjection &projection = model.Projection();
+
+    std::vector<double> lat, lon;
+    for (int i = 0; i <= 17000; i++) {
+        lat.push_back(-85.0 + i * 0.01);
+        lon.push_back(-179.99 + i * 0.021);
+    }
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2}) {
+        if (!IsSupported(level))
+            continue;
+        std::vector<double> x(lat.size()), y(lat.size());
+        projection.Project(lat.data(), lon.data(), x.data(), y.data(), lat.size(), level);
+        for (size_t i = 0; i < lat.size(); i++) {
+            EXPECT_NEAR(x[i] * projection.scale, projection.ProjectLon(lon[i]) * projection.scale, 1e-6);
+            EXPECT_NEAR(y[i] * projection.scale, projection.ProjectLat(lat[i]) * projection.scale, 1e-6);
+        }
+    }
+}
+
+TEST(ModelTest, ParseCoordinate) {
+    double value;
+    for (const char *str : {"30.2705900", "-97.7454100", "0", "-0.0000001", "179.9999999", "12.", "+3.5", "1e-3",
+                            "0.1234567890123456789"}) {
+        ASSERT_TRUE(ParseCoordinate(str, value)) << str;
+        EXPECT_EQ(value, atof(str)) << str;
+    }
+    for (const char *str : {"", "-", ".", "12a", "1.2.3", "+-1", " 1"})
+        EXPECT_FALSE(ParseCoordinate(str, value)) << str;
+
+    // Values are parsed in place, without relying on a terminator.
+    std::string_view view = std::string_view{"54.0889580\""}.substr(0, 10);
+    ASSERT_TRUE(ParseCoordinate(view, value));
+    EXPECT_EQ(value, 54.0889580);
+}
+
+TEST(ModelTest, IdIndexLookup) {
+    IdIndex ascending;
+    for (std::int64_t id : std::vector<std::int64_t>{3, 17, 9000000000, 9000000001})
+        ascending.Add(id);
+    ascending.Finalize();
+    EXPECT_EQ(ascending.Find(3), 0);
+    EXPECT_EQ(ascending.Find(9000000001), 3);
+    EXPECT_EQ(ascending.Find(4), -1);
+
+    // Unordered ids go through the sorted permutation, repeated ids resolve to the last one.
+    IdIndex unordered;
+    for (std::int64_t id : std::vector<std::int64_t>{42, 7, 9000000000, 7, -5})
+        unordered.Add(id);
+    unordered.Finalize();
+    EXPECT_EQ(unordered.Find(42), 0);
+    EXPECT_EQ(unordered.Find(7), 3);
+    EXPECT_EQ(unordered.Find(9000000000), 2);
+    EXPECT_EQ(unordered.Find(-5), 4);
+    EXPECT_EQ(unordered.Find(8), -1);
+}
+
+static std::vector<std::byte> WriteSnapshot(const Model &model) {
+    std::stringstream ss;
+    model.SaveSnapshot(ss);
+    auto str = ss.str();
+    std::vector<std::byte> snapshot(str.size());
+    std::memcpy(snapshot.data(), str.data(), str.size());
+    return snapshot;
+}
+
+// Recomputes the checksum of a snapshot edited in place, so that only the
+// loader's own checks can reject the edit.
+static void ResealSnapshot(std::vector<std::byte> &snapshot) {
+    SnapshotHeader header;
+    std::memcpy(&header, snapshot.data(), sizeof(header));
+    header.checksum = Checksum(snapshot.data() + sizeof(header), snapshot.size() - sizeof(header));
+    std::memcpy(snapshot.data(), &header, sizeof(header));
+}
+
+static void ExpectCorrupted(const std::vector<std::byte> &snapshot) {
+    try {
+        RouteModel loaded{snapshot};
+        ADD_FAILURE() << "the corrupted snapshot was accepted";
+    }
+    catch (const std::logic_error &e) {
+        EXPECT_STREQ(e.what(), "snapshot is corrupted");
+    }
+}
+
+// A model loaded back from its snapshot must be identical to the one parsed from XML.
+TEST(ModelTest, SnapshotRoundTrip) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    Model model{osm_data};
+    std::vector<std::byte> snapshot = WriteSnapshot(model);
+    ASSERT_TRUE(Model::IsSnapshot(snapshot));
+    ASSERT_FALSE(Model::IsSnapshot(osm_data));
+    Model loaded{snapshot};
+    ExpectSameModel(model, loaded);
+}
+
+TEST(ModelTest, SnapshotCorruptionIsDetected) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    std::vector<std::byte> snapshot = WriteSnapshot(Model{osm_data});
+    snapshot[snapshot.size() / 2] ^= std::byte{0x5a};
+    EXPECT_THROW(Model{snapshot}, std::logic_error);
+    snapshot.resize(snapshot.size() / 2);
+    EXPECT_THROW(Model{snapshot}, std::logic_error);
+}
+
+// Out-of-range indices and enum values are rejected even when the checksum
+// matches. The last section of the payload is the landuse types.
+TEST(ModelTest, SnapshotIndicesAreChecked) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    Model model{osm_data};
+    ASSERT_FALSE(model.Landuses().empty());
+    std::vector<std::byte> snapshot = WriteSnapshot(model);
+    size_t padding = model.Landuses().size() % 2 * sizeof(std::int32_t);
+    std::int32_t type = Model::Landuse::Residential + 1;
+    std::memcpy(snapshot.data() + snapshot.size() - padding - sizeof(type), &type, sizeof(type));
+    ResealSnapshot(snapshot);
+    ExpectCorrupted(snapshot);
+}
+
+// A route model's snapshot carries its routing indices, which load without
+// being rebuilt and answer queries the same way.
+TEST(ModelTest, RouteSnapshotRoundTrip) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    std::vector<std::byte> snapshot = WriteSnapshot(model);
+    RouteModel loaded{snapshot};
+    ExpectSameModel(model, loaded);
+    ExpectSameModel(model, Model{snapshot});
+    EXPECT_EQ(loaded.Stats().Seconds(LoadStats::Phase::RouteGraph), 0.);
+    EXPECT_EQ(loaded.Graph().Checksum(), model.Graph().Checksum());
+    ASSERT_EQ(loaded.Components().Count(), model.Components().Count());
+    for (int node = 0; node < model.Graph().NodeCount(); ++node) {
+        ASSERT_EQ(loaded.Components().Of(node), model.Components().Of(node));
+        auto roads = model.NodeRoads(node), loaded_roads = loaded.NodeRoads(node);
+        ASSERT_TRUE(std::equal(roads.begin(), roads.end(), loaded_roads.begin(), loaded_roads.end()));
+    }
+
+    std::mt19937 rng{31};
+    std::uniform_real_distribution<float> coordinate{0.f, 1.f};
+    for (int query = 0; query < 64; ++query) {
+        float x = coordinate(rng), y = coordinate(rng);
+        EXPECT_EQ(loaded.FindClosestNode(x, y).Index(), model.FindClosestNode(x, y).Index());
+        EdgePoint point = model.SnapToEdge(x, y), loaded_point = loaded.SnapToEdge(x, y);
+        EXPECT_EQ(loaded_point.from, point.from);
+        EXPECT_EQ(loaded_point.to, point.to);
+        EXPECT_EQ(loaded_point.distance, point.distance);
+    }
+
+    // The last section is the segment grid's cell lists; a segment number past
+    // the end must be caught whether or not the array ends in padding.
+    std::int32_t segment[2] = {std::numeric_limits<std::int32_t>::max(), std::numeric_limits<std::int32_t>::max()};
+    std::memcpy(snapshot.data() + snapshot.size() - sizeof(segment), segment, sizeof(segment));
+    ResealSnapshot(snapshot);
+    ExpectCorrupted(snapshot);
+}
+
+// The k-d tree must find what a scan over every non-footway road node finds.
+TEST(ModelTest, FindClosestNodeMatchesScan) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    std::vector<int> routable;
+    for (const Model::Road &road : model.Roads())
+        if (road.type != Model::Road::Type::Footway)
+            for (int node : model.Ways()[road.way].nodes)
+                routable.push_back(node);
+    std::sort(routable.begin(), routable.end());
+    routable.erase(std::unique(routable.begin(), routable.end()), routable.end());
+    EXPECT_EQ(model.Stats().Memory(LoadStats::Container::SpatialIndex).count, routable.size());
+
+    std::mt19937 rng{17};
+    std::uniform_real_distribution<float> coordinate{-0.1f, 1.1f};
+    for (int query = 0; query < 200; ++query) {
+        float x = coordinate(rng), y = coordinate(rng);
+        Model::Node input{x, y};
+        std::vector<float> distances;
+        for (int node : routable)
+            distances.push_back(RouteModel::Distance(input, model.Nodes()[node]));
+        std::sort(distances.begin(), distances.end());
+
+        EXPECT_NEAR(RouteModel::Distance(input, model.FindClosestNode(x, y).Position()), distances[0], 1e-6);
+        auto closest = model.FindClosestNodes(x, y, 8);
+        ASSERT_EQ(closest.size(), 8);
+        for (size_t i = 0; i < closest.size(); ++i)
+            EXPECT_NEAR(RouteModel::Distance(input, closest[i].Position()), distances[i], 1e-6);
+    }
+    EXPECT_TRUE(model.FindClosestNodes(0.5f, 0.5f, 0).empty());
+    EXPECT_EQ(model.FindClosestNodes(0.5f, 0.5f, routable.size() + 5).size(), routable.size());
+}
+
+// A map whose only way is a footway has nothing to snap to.
+TEST(ModelTest, FindClosestNodeWithoutRoads) {
+    std::string xml = R"(<osm version="0.6">
+ <bounds minlat="30.27" minlon="-97.75" maxlat="30.28" maxlon="-97.73"/>
+ <node id="1" lat="30.271" lon="-97.741"/>
+ <node id="2" lat="30.272" lon="-97.742"/>
+ <way id="10"><nd ref="1"/><nd ref="2"/><tag k="highway" v="footway"/></way>
+</osm>)";
+    std::vector<std::byte> osm_data(xml.size());
+    std::memcpy(osm_data.data(), xml.data(), xml.size());
+    RouteModel model{osm_data};
+    ASSERT_EQ(model.Roads().size(), 1);
+    EXPECT_TRUE(model.FindClosestNodes(0.5f, 0.5f, 4).empty());
+    EXPECT_THROW(model.FindClosestNode(0.5f, 0.5f), std::logic_error);
+    EXPECT_THROW(model.FindClosestNode(0.5f, 0.5f, RouteModel::SnapScope::LargestComponent), std::logic_error);
+    EXPECT_THROW((RoutePlanner{model, 10.f, 10.f, 90.f, 90.f}), std::logic_error);
+}
+
+// Every node of a non-footway road lists that road once, and no other node lists any.
+TEST(ModelTest, NodeRoadsMatchWays) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    std::vector<std::vector<int>> expected(model.Nodes().size());
+    for (size_t road = 0; road < model.Roads().size(); ++road)
+        if (model.Roads()[road].type != Model::Road::Type::Footway)
+            for (int node : model.Ways()[model.Roads()[road].way].nodes)
+                if (expected[node].empty() || expected[node].back() != (int)road)
+                    expected[node].push_back((int)road);
+    size_t entries = 0;
+    for (size_t node = 0; node < expected.size(); ++node) {
+        auto roads = model.NodeRoads((int)node);
+        ASSERT_EQ(std::vector<int>(roads.begin(), roads.end()), expected[node]) << node;
+        entries += roads.size();
+    }
+    EXPECT_EQ(model.Stats().Memory(LoadStats::Container::NodeToRoad).count, entries);
+}
+
+// Batches are answered out of order, and must agree with single lookups.
+TEST(ModelTest, SnapToNodesMatchesSingleLookups) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    std::mt19937 rng{23};
+    std::uniform_real_distribution<float> coordinate{-0.2f, 1.2f};
+    std::vector<float> x(5000), y(5000);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = coordinate(rng);
+        y[i] = coordinate(rng);
+    }
+    KdTree tree{[&] {
+        std::vector<KdTree::Point> points;
+        auto &model_nodes = model.Nodes();
+        for (size_t i = 0; i < model_nodes.size(); ++i)
+            points.push_back({(float)model_nodes.X(i), (float)model_nodes.Y(i), (int)i});
+        return points;
+    }()};
+    std::vector<int> nodes(x.size());
+    std::vector<float> distances(x.size());
+    tree.Nearest(x, y, nodes, distances);
+    for (size_t i = 0; i < x.size(); ++i) {
+        ASSERT_EQ(nodes[i], tree.Nearest(x[i], y[i]));
+        EXPECT_NEAR(distances[i], std::hypot(model.Nodes().X(nodes[i]) - x[i], model.Nodes().Y(nodes[i]) - y[i]), 1e-6);
+    }
+
+    model.SnapToNodes(x, y, nodes, distances);
+    for (size_t i = 0; i < x.size(); ++i)
+        ASSERT_EQ(nodes[i], model.FindClosestNode(x[i], y[i]).Index());
+
+    // Every span must be as long as x.
+    Span<const float> short_y{y.data(), y.size() - 1};
+    Span<int> short_nodes{nodes.data(), nodes.size() - 1};
+    Span<float> short_distances{distances.data(), distances.size() - 1};
+    EXPECT_THROW(model.SnapToNodes(x, short_y, nodes, distances), std::invalid_argument);
+    EXPECT_THROW(model.SnapToNodes(x, y, short_nodes, distances), std::invalid_argument);
+    EXPECT_THROW(model.SnapToNodes(x, y, nodes, short_distances), std::invalid_argument);
+}
+
+
 //--------------------------------//
 //   Beginning RoutePlanner Tests.
 //--------------------------------//
@@ -42,7 +537,7 @@ std::vector<std::byte> ReadOSMData(const std::string &path) {
 class RoutePlannerTest : public ::testing::Test {
   protected:
     std::string osm_data_file = "../map.osm";
-    std::vector<std::byte> osm_data = ReadOSMData(osm_data_file);
+    MappedFile osm_data = ReadOSMData(osm_data_file);
     RouteModel model{osm_data};
     RoutePlanner route_planner{model, 10, 10, 90, 90};
     
@@ -51,44 +546,45 @@ class RoutePlannerTest : public ::testing::Test {
     float start_y = 0.1;
     float end_x = 0.9;
     float end_y = 0.9;
-    RouteModel::Node* start_node = &model.FindClosestNode(start_x, start_y);
-    RouteModel::Node* end_node = &model.FindClosestNode(end_x, end_y);
+    RouteModel::Node start_node = model.FindClosestNode(start_x, start_y);
+    RouteModel::Node end_node = model.FindClosestNode(end_x, end_y);
 
     // Construct another node in the middle of the map for testing.
     float mid_x = 0.5;
     float mid_y = 0.5;
-    RouteModel::Node* mid_node = &model.FindClosestNode(mid_x, mid_y);
+    RouteModel::Node mid_node = model.FindClosestNode(mid_x, mid_y);
 };
 
 
 // Test the CalculateHValue method.
 TEST_F(RoutePlannerTest, TestCalculateHValue) {
-    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(start_node), 1.1329799);
-    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(end_node), 0.0f);
-    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(mid_node), 0.58903033);
+    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(start_node.Index()), 1.1329799);
+    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(end_node.Index()), 0.0f);
+    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(mid_node.Index()), 0.58903033);
 }
 
 
 
 // Test the AddNeighbors method.
-bool NodesSame(RouteModel::Node* a, RouteModel::Node* b) { return a == b; }
 TEST_F(RoutePlannerTest, TestAddNeighbors) {
-    route_planner.AddNeighbors(start_node);
+    route_planner.AddNeighbors(start_node.Index());
 
     // Correct h and g values for the neighbors of start_node.
     std::vector<float> start_neighbor_g_vals{ 0.051776856, 0.055291083, 0.082997195, 0.10671431 };
     std::vector<float> start_neighbor_h_vals{ 1.0858033, 1.1831238, 1.0998145, 1.1828455 };
-    auto neighbors = start_node->neighbors;
+    const SearchWorkspace &workspace = route_planner.Workspace();
+    auto targets = model.Graph().Targets(start_node.Index());
+    std::vector<int> neighbors(targets.begin(), targets.end());
     std::sort(std::begin(neighbors), std::end(neighbors),
-        [](RouteModel::Node* a, RouteModel::Node* b) { return a->g_value < b->g_value; });
+        [&workspace](int a, int b) { return workspace.GValue(a) < workspace.GValue(b); });
     EXPECT_EQ(neighbors.size(), 4);
 
     // Check results for each neighbor.
     for (int i = 0; i < neighbors.size(); i++) {
-        EXPECT_PRED2(NodesSame, neighbors[i]->parent, start_node);
-        EXPECT_FLOAT_EQ(neighbors[i]->g_value, start_neighbor_g_vals[i]);
-        EXPECT_FLOAT_EQ(neighbors[i]->h_value, start_neighbor_h_vals[i]);
-        EXPECT_EQ(neighbors[i]->visited, true);
+        EXPECT_EQ(workspace.Visited(neighbors[i]), true);
+        EXPECT_EQ(workspace.Parent(neighbors[i]), start_node.Index());
+        EXPECT_FLOAT_EQ(workspace.GValue(neighbors[i]), start_neighbor_g_vals[i]);
+        EXPECT_FLOAT_EQ(workspace.HValue(neighbors[i]), start_neighbor_h_vals[i]);
     }
 }
 
@@ -96,29 +592,508 @@ TEST_F(RoutePlannerTest, TestAddNeighbors) {
 // Test the ConstructFinalPath method.
 TEST_F(RoutePlannerTest, TestConstructFinalPath) {
     // Construct a path.
-    mid_node->parent = start_node;
-    end_node->parent = mid_node;
-    std::vector<RouteModel::Node> path = route_planner.ConstructFinalPath(end_node);
+    SearchWorkspace &workspace = route_planner.Workspace();
+    workspace.Visit(start_node.Index());
+    workspace.Visit(mid_node.Index());
+    workspace.Visit(end_node.Index());
+    workspace.Parent(mid_node.Index()) = start_node.Index();
+    workspace.Parent(end_node.Index()) = mid_node.Index();
+    std::vector<Model::Node> path = route_planner.ConstructFinalPath(end_node.Index());
 
     // Test the path.
     EXPECT_EQ(path.size(), 3);
-    EXPECT_FLOAT_EQ(start_node->x, path.front().x);
-    EXPECT_FLOAT_EQ(start_node->y, path.front().y);
-    EXPECT_FLOAT_EQ(end_node->x, path.back().x);
-    EXPECT_FLOAT_EQ(end_node->y, path.back().y);
+    EXPECT_FLOAT_EQ(start_node.X(), path.front().x);
+    EXPECT_FLOAT_EQ(start_node.Y(), path.front().y);
+    EXPECT_FLOAT_EQ(end_node.X(), path.back().x);
+    EXPECT_FLOAT_EQ(end_node.Y(), path.back().y);
 }
 
 
 // Test the AStarSearch method.
 TEST_F(RoutePlannerTest, TestAStarSearch) {
     route_planner.AStarSearch();
-    EXPECT_EQ(model.path.size(), 33);
-    RouteModel::Node path_start = model.path.front();
-    RouteModel::Node path_end = model.path.back();
+    auto &path = route_planner.GetPath();
+    EXPECT_EQ(path.size(), 70);
+    Model::Node path_start = path.front();
+    Model::Node path_end = path.back();
     // The start_node and end_node x, y values should be the same as in the path.
-    EXPECT_FLOAT_EQ(start_node->x, path_start.x);
-    EXPECT_FLOAT_EQ(start_node->y, path_start.y);
-    EXPECT_FLOAT_EQ(end_node->x, path_end.x);
-    EXPECT_FLOAT_EQ(end_node->y, path_end.y);
-    EXPECT_FLOAT_EQ(route_planner.GetDistance(), 873.41565);
+    EXPECT_FLOAT_EQ(start_node.X(), path_start.x);
+    EXPECT_FLOAT_EQ(start_node.Y(), path_start.y);
+    EXPECT_FLOAT_EQ(end_node.X(), path_end.x);
+    EXPECT_FLOAT_EQ(end_node.Y(), path_end.y);
+    EXPECT_FLOAT_EQ(route_planner.GetDistance(), 839.26294);
+}
+
+
+// RadixHeap picks buckets by the bit width of keys.
+TEST(PriorityQueueBitWidthTest, MatchesShifts) {
+    EXPECT_EQ(BitWidth(0), 0);
+    for (size_t width = 1; width <= 32; ++width) {
+        std::uint32_t low = 1u << (width - 1);
+        EXPECT_EQ(BitWidth(low), width);
+        EXPECT_EQ(BitWidth(low | (low - 1)), width);
+    }
+}
+
+// Every open list backend of BasicRoutePlanner.
+template <typename Queue>
+class PriorityQueueTest : public ::testing::Test {};
+typedef ::testing::Types<IndexedHeap, PairingHeap, RadixHeap, BucketQueue> QueueTypes;
+TYPED_TEST_CASE(PriorityQueueTest, QueueTypes);
+
+// Pops come out in key order, also after keys were decreased in place. Keys
+// are multiples of 1/1024 up to one model unit, which the quantising queues
+// represent exactly.
+TYPED_TEST(PriorityQueueTest, PopsInKeyOrderAfterDecreaseKey) {
+    std::mt19937 rng{3};
+    std::uniform_int_distribution<int> steps{0, 1024};
+    TypeParam queue;
+    for (int round = 0; round < 2; ++round) {
+        queue.Reset(1000);
+        std::vector<float> keys(1000);
+        for (int node = 0; node < 1000; ++node) {
+            keys[node] = steps(rng) / 1024.f;
+            queue.Push(node, keys[node]);
+        }
+        for (int node = 0; node < 1000; node += 3) {
+            keys[node] *= 0.5f;
+            queue.DecreaseKey(node, keys[node]);
+            queue.DecreaseKey(node, keys[node] + 1.f);
+        }
+        // Leave half of the nodes queued to check that Reset() forgets them.
+        float last = 0.f;
+        for (int i = 0; i < 500; ++i) {
+            if constexpr (std::is_same_v<TypeParam, IndexedHeap>) {
+                EXPECT_EQ(queue.Key(queue.Top()), keys[queue.Top()]);
+            }
+            int node = queue.Pop();
+            EXPECT_FALSE(queue.Contains(node));
+            EXPECT_LE(last, keys[node]);
+            last = keys[node];
+        }
+        EXPECT_EQ(queue.Size(), 500);
+    }
+}
+
+
+// Reference shortest path length over the route graph, in model units.
+static float DijkstraDistance(const RouteGraph &graph, int from, int to) {
+    std::vector<float> dist(graph.NodeCount(), std::numeric_limits<float>::infinity());
+    using Entry = std::pair<float, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    dist[from] = 0.f;
+    queue.push({0.f, from});
+    while (!queue.empty()) {
+        auto [d, node] = queue.top();
+        queue.pop();
+        if (node == to)
+            return d;
+        if (d > dist[node])
+            continue;
+        auto targets = graph.Targets(node);
+        auto lengths = graph.Lengths(node);
+        for (size_t i = 0; i < targets.size(); ++i)
+            if (d + lengths[i] < dist[targets[i]]) {
+                dist[targets[i]] = d + lengths[i];
+                queue.push({dist[targets[i]], targets[i]});
+            }
+    }
+    return std::numeric_limits<float>::infinity();
+}
+
+// Node numbers along a path of positions, found by following the graph's
+// edges from start. Stops short where no edge leads to the next position.
+static std::vector<int> PathNodes(const RouteModel &model, int start, const std::vector<Model::Node> &path) {
+    auto same = [&](int node, const Model::Node &position) {
+        return model.Nodes().X(node) == position.x && model.Nodes().Y(node) == position.y;
+    };
+    std::vector<int> nodes;
+    if (path.empty() || !same(start, path[0]))
+        return nodes;
+    nodes.push_back(start);
+    for (size_t i = 1; i < path.size(); ++i) {
+        auto targets = model.Graph().Targets(nodes.back());
+        auto it = std::find_if(targets.begin(), targets.end(), [&](int target) { return same(target, path[i]); });
+        if (it == targets.end())
+            break;
+        nodes.push_back(*it);
+    }
+    return nodes;
+}
+
+// Length of one key step of a quantising queue in model units, 0 if exact.
+template <typename Queue> float KeyStep() { return 0.f; }
+template <> float KeyStep<RadixHeap>() { return 1.f / RadixHeap::kScale; }
+template <> float KeyStep<BucketQueue>() { return 1.f / BucketQueue::kScale; }
+
+// A* over the route graph must find true shortest paths with every open list
+// and in both search modes, give or take one key step per edge for the
+// quantising queues.
+template <typename Queue>
+class RoutePlannerQueueTest : public ::testing::Test {};
+TYPED_TEST_CASE(RoutePlannerQueueTest, QueueTypes);
+
+TYPED_TEST(RoutePlannerQueueTest, AStarMatchesDijkstra) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    BasicSearchWorkspace<TypeParam> workspace;
+    std::mt19937 rng{7};
+    std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+    for (int query = 0; query < 16; ++query) {
+        float start_x = coordinate(rng), start_y = coordinate(rng), end_x = coordinate(rng), end_y = coordinate(rng);
+        int start = model.FindClosestNode(start_x * 0.01f, start_y * 0.01f).Index();
+        int end = model.FindClosestNode(end_x * 0.01f, end_y * 0.01f).Index();
+        float expected = DijkstraDistance(model.Graph(), start, end);
+        using Mode = typename BasicRoutePlanner<TypeParam>::SearchMode;
+        for (Mode mode : {Mode::Forward, Mode::Bidirectional}) {
+            BasicRoutePlanner<TypeParam> planner{model, workspace, start_x, start_y, end_x, end_y};
+            planner.AStarSearch(mode);
+            if (std::isinf(expected)) {
+                EXPECT_TRUE(planner.GetPath().empty());
+                continue;
+            }
+            float tolerance = 1e-3f + planner.GetPath().size() * KeyStep<TypeParam>() * model.MetricScale();
+            EXPECT_NEAR(planner.GetDistance(), expected * model.MetricScale(), tolerance);
+        }
+    }
+}
+
+
+// Bidirectional search finds routes as long as the forward search's, joined
+// up from the start node to the end node.
+TEST(RoutePlannerGraphTest, BidirectionalMatchesForward) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    SearchWorkspace workspace;
+    std::mt19937 rng{5};
+    std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+    for (int query = 0; query < 64; ++query) {
+        float start_x = coordinate(rng), start_y = coordinate(rng), end_x = coordinate(rng), end_y = coordinate(rng);
+        RoutePlanner forward{model, workspace, start_x, start_y, end_x, end_y};
+        forward.AStarSearch();
+        std::vector<Model::Node> forward_path = forward.GetPath();
+        RoutePlanner bidirectional{model, workspace, start_x, start_y, end_x, end_y};
+        bidirectional.AStarSearch(RoutePlanner::SearchMode::Bidirectional);
+
+        auto &path = bidirectional.GetPath();
+        ASSERT_EQ(path.empty(), forward_path.empty());
+        if (path.empty())
+            continue;
+        EXPECT_NEAR(bidirectional.GetDistance(), forward.GetDistance(), 1e-3);
+        int start = model.FindClosestNode(start_x * 0.01f, start_y * 0.01f).Index();
+        int end = model.FindClosestNode(end_x * 0.01f, end_y * 0.01f).Index();
+        auto nodes = PathNodes(model, start, path);
+        ASSERT_EQ(nodes.size(), path.size());
+        EXPECT_EQ(nodes.back(), end);
+        auto forward_nodes = PathNodes(model, start, forward_path);
+        ASSERT_EQ(forward_nodes.size(), forward_path.size());
+        EXPECT_EQ(forward_nodes.back(), end);
+    }
+}
+
+
+// Landmark bounds never exceed true route lengths, and A* with them finds the
+// same routes while settling fewer nodes.
+TEST(RoutePlannerGraphTest, LandmarksTightenTheHeuristic) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    Landmarks landmarks{model.Graph(), 8};
+    EXPECT_EQ(landmarks.Count(), 8);
+
+    SearchWorkspace workspace;
+    std::mt19937 rng{9};
+    std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+    size_t plain_settled = 0, landmark_settled = 0;
+    for (int query = 0; query < 32; ++query) {
+        float start_x = coordinate(rng), start_y = coordinate(rng), end_x = coordinate(rng), end_y = coordinate(rng);
+        int start = model.FindClosestNode(start_x * 0.01f, start_y * 0.01f).Index();
+        int end = model.FindClosestNode(end_x * 0.01f, end_y * 0.01f).Index();
+        float expected = DijkstraDistance(model.Graph(), start, end);
+        EXPECT_LE(landmarks.LowerBound(start, end), expected * (1 + 1e-5f));
+
+        RoutePlanner plain{model, workspace, start_x, start_y, end_x, end_y};
+        plain.AStarSearch();
+        plain_settled += plain.GetSettledCount();
+        float plain_distance = plain.GetDistance();
+        for (auto mode : {RoutePlanner::SearchMode::Forward, RoutePlanner::SearchMode::Bidirectional}) {
+            RoutePlanner planner{model, workspace, start_x, start_y, end_x, end_y};
+            planner.SetLandmarks(&landmarks);
+            planner.AStarSearch(mode);
+            EXPECT_NEAR(planner.GetDistance(), plain_distance, 1e-3);
+            if (mode == RoutePlanner::SearchMode::Forward)
+                landmark_settled += planner.GetSettledCount();
+        }
+    }
+    EXPECT_LT(landmark_settled, plain_settled);
+}
+
+
+TEST(RoutePlannerGraphTest, LandmarksRoundTrip) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    Landmarks landmarks{model.Graph(), 4};
+    std::ostringstream os;
+    landmarks.Save(os);
+    std::string saved = os.str();
+    Span<const std::byte> data{reinterpret_cast<const std::byte *>(saved.data()), saved.size()};
+    ASSERT_TRUE(Landmarks::IsLandmarks(data));
+    EXPECT_FALSE(Model::IsSnapshot(data));
+
+    Landmarks loaded{data, model.Graph()};
+    EXPECT_EQ(loaded.Nodes(), landmarks.Nodes());
+    for (int node = 0; node < model.Graph().NodeCount(); node += 97)
+        for (int l = 0; l < landmarks.Count(); ++l)
+            EXPECT_EQ(loaded.Distance(l, node), landmarks.Distance(l, node));
+
+    Model::LoadOptions options;
+    options.layers = Model::LoadOptions::Roads;
+    RouteModel other{osm_data, options};
+    RouteGraph fewer_nodes{other};
+    EXPECT_THROW((Landmarks{data, fewer_nodes}), std::logic_error);
+
+    // The same map with latitude and longitude swapped: every count is the
+    // same, but the edge lengths are not.
+    std::string text{reinterpret_cast<const char *>(osm_data.data()), osm_data.size()};
+    auto rename = [&text](const char *from, const char *to) {
+        for (size_t at = 0; (at = text.find(from, at)) != std::string::npos; at += 6)
+            text.replace(at, 6, to);
+    };
+    rename(" lat=\"", " tmp=\"");
+    rename(" lon=\"", " lat=\"");
+    rename(" tmp=\"", " lon=\"");
+    RouteModel swapped{Span<const std::byte>{reinterpret_cast<const std::byte *>(text.data()), text.size()}};
+    ASSERT_EQ(swapped.Graph().NodeCount(), model.Graph().NodeCount());
+    ASSERT_EQ(swapped.Graph().EdgeCount(), model.Graph().EdgeCount());
+    EXPECT_NE(swapped.Graph().Checksum(), model.Graph().Checksum());
+    EXPECT_THROW((Landmarks{data, swapped.Graph()}), std::logic_error);
+}
+
+
+// Contraction hierarchy queries find shortest routes, unpacked to chains of
+// original graph edges from the start node to the end node.
+TEST(RoutePlannerGraphTest, ContractionHierarchyMatchesDijkstra) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    ContractionHierarchy hierarchy{model.Graph()};
+    EXPECT_EQ(hierarchy.NodeCount(), model.Graph().NodeCount());
+
+    SearchWorkspace workspace;
+    std::mt19937 rng{13};
+    std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+    for (int query = 0; query < 64; ++query) {
+        float start_x = coordinate(rng), start_y = coordinate(rng), end_x = coordinate(rng), end_y = coordinate(rng);
+        int start = model.FindClosestNode(start_x * 0.01f, start_y * 0.01f).Index();
+        int end = model.FindClosestNode(end_x * 0.01f, end_y * 0.01f).Index();
+        float expected = DijkstraDistance(model.Graph(), start, end);
+        CHPlanner planner{model, hierarchy, workspace, start_x, start_y, end_x, end_y};
+        planner.Search();
+        auto &path = planner.GetPath();
+        if (std::isinf(expected)) {
+            EXPECT_TRUE(path.empty());
+            continue;
+        }
+        ASSERT_FALSE(path.empty());
+        auto nodes = PathNodes(model, start, path);
+        ASSERT_EQ(nodes.size(), path.size());
+        EXPECT_EQ(nodes.back(), end);
+        float length = 0.f;
+        for (size_t i = 1; i < nodes.size(); ++i) {
+            auto targets = model.Graph().Targets(nodes[i - 1]);
+            auto it = std::lower_bound(targets.begin(), targets.end(), nodes[i]);
+            length += model.Graph().Lengths(nodes[i - 1])[it - targets.begin()];
+        }
+        EXPECT_NEAR(length, expected, 1e-5);
+        EXPECT_NEAR(planner.GetDistance(), expected * model.MetricScale(), 1e-2);
+    }
+}
+
+
+// Contraction rounds are applied in node order, so the thread count does not change the hierarchy.
+TEST(RoutePlannerGraphTest, ContractionHierarchyIsDeterministic) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    ContractionHierarchy sequential{model.Graph(), 1};
+    ContractionHierarchy parallel{model.Graph(), 4};
+    ASSERT_EQ(sequential.NodeCount(), parallel.NodeCount());
+    EXPECT_EQ(sequential.ShortcutCount(), parallel.ShortcutCount());
+    for (int node = 0; node < sequential.NodeCount(); ++node) {
+        ASSERT_EQ(sequential.Rank(node), parallel.Rank(node));
+        auto targets = sequential.UpTargets(node), parallel_targets = parallel.UpTargets(node);
+        auto lengths = sequential.UpLengths(node), parallel_lengths = parallel.UpLengths(node);
+        ASSERT_EQ(targets.size(), parallel_targets.size());
+        for (size_t i = 0; i < targets.size(); ++i) {
+            EXPECT_EQ(targets[i], parallel_targets[i]);
+            EXPECT_EQ(lengths[i], parallel_lengths[i]);
+        }
+    }
+}
+
+
+// Snapping to edges starts and ends on the road segments closest to the query
+// points; the route leaves and enters them through their ends, or follows the
+// segment directly when both points lie on the same one.
+TEST(RoutePlannerGraphTest, EdgeSnapMatchesDijkstra) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    Landmarks landmarks{model.Graph(), 8};
+    SearchWorkspace workspace;
+    std::mt19937 rng{19};
+    std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+    for (int query = 0; query < 32; ++query) {
+        float start_x = coordinate(rng), start_y = coordinate(rng), end_x = coordinate(rng), end_y = coordinate(rng);
+        EdgePoint start = model.SnapToEdge(start_x * 0.01f, start_y * 0.01f);
+        EdgePoint end = model.SnapToEdge(end_x * 0.01f, end_y * 0.01f);
+        ASSERT_GE(start.from, 0);
+        RouteModel::Node closest = model.FindClosestNode(start_x * 0.01f, start_y * 0.01f);
+        if (model.Graph().Degree(closest.Index()) > 0) {
+            EXPECT_LE(start.distance, std::hypot(closest.X() - start_x * 0.01f, closest.Y() - start_y * 0.01f) + 1e-6f);
+        }
+
+        // Distances from each snapped point to the ends of its segment.
+        auto offset = [&](const EdgePoint &point, int node) {
+            return (float)std::hypot(point.x - model.Nodes().X(node), point.y - model.Nodes().Y(node));
+        };
+        float expected = std::numeric_limits<float>::infinity();
+        for (int a : {start.from, start.to})
+            for (int b : {end.from, end.to})
+                expected = std::min(expected, offset(start, a) + DijkstraDistance(model.Graph(), a, b) + offset(end, b));
+        if (start.from == end.from && start.to == end.to)
+            expected = std::min(expected, std::hypot(start.x - end.x, start.y - end.y));
+
+        for (const Landmarks *alt : {(const Landmarks *)nullptr, (const Landmarks *)&landmarks})
+            for (auto mode : {RoutePlanner::SearchMode::Forward, RoutePlanner::SearchMode::Bidirectional}) {
+                RoutePlanner planner{model, workspace, start_x, start_y, end_x, end_y, RoutePlanner::Snap::Edge};
+                planner.SetLandmarks(alt);
+                planner.AStarSearch(mode);
+                auto &path = planner.GetPath();
+                if (std::isinf(expected)) {
+                    EXPECT_TRUE(path.empty());
+                    continue;
+                }
+                ASSERT_GE(path.size(), 2);
+                EXPECT_NEAR(path.front().x, start.x, 1e-6);
+                EXPECT_NEAR(path.front().y, start.y, 1e-6);
+                EXPECT_NEAR(path.back().x, end.x, 1e-6);
+                EXPECT_NEAR(path.back().y, end.y, 1e-6);
+                EXPECT_NEAR(planner.GetDistance(), expected * model.MetricScale(), 1e-2);
+            }
+    }
+}
+
+
+// Components are exactly the sets of nodes reachable from each other, largest
+// first; queries across them return nothing without searching, and snapping
+// to the largest component always gives a route.
+TEST(RoutePlannerGraphTest, ComponentsMatchReachability) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    const RouteGraph &graph = model.Graph();
+    const GraphComponents &components = model.Components();
+    ASSERT_EQ(components.Labels().size(), (size_t)graph.NodeCount());
+    std::vector<bool> reached(graph.NodeCount(), false), label_seen(components.Count(), false);
+    for (int root = 0; root < graph.NodeCount(); ++root) {
+        if (reached[root])
+            continue;
+        int label = components.Of(root);
+        ASSERT_FALSE(label_seen[label]);
+        label_seen[label] = true;
+        std::vector<int> stack{root};
+        reached[root] = true;
+        size_t size = 0;
+        while (!stack.empty()) {
+            int node = stack.back();
+            stack.pop_back();
+            ++size;
+            EXPECT_EQ(components.Of(node), label);
+            for (int target : graph.Targets(node))
+                if (!reached[target]) {
+                    reached[target] = true;
+                    stack.push_back(target);
+                }
+        }
+        EXPECT_EQ(components.Size(label), size);
+    }
+    for (int c = 1; c < components.Count(); ++c)
+        EXPECT_GE(components.Size(c - 1), components.Size(c));
+
+    // A road node outside the largest component, and one inside it.
+    int inside = -1, outside = -1;
+    for (int node = 0; node < graph.NodeCount(); ++node)
+        if (graph.Degree(node) > 0)
+            (components.Of(node) == 0 ? inside : outside) = node;
+    ASSERT_GE(inside, 0);
+    ASSERT_GE(outside, 0);
+    auto &nodes = model.Nodes();
+    float inside_x = nodes[inside].x * 100.f, inside_y = nodes[inside].y * 100.f;
+    float outside_x = nodes[outside].x * 100.f, outside_y = nodes[outside].y * 100.f;
+    ContractionHierarchy hierarchy{graph};
+    RoutePlanner planner{model, inside_x, inside_y, outside_x, outside_y};
+    CHPlanner ch_planner{model, hierarchy, inside_x, inside_y, outside_x, outside_y};
+    for (auto mode : {RoutePlanner::SearchMode::Forward, RoutePlanner::SearchMode::Bidirectional}) {
+        planner.AStarSearch(mode);
+        EXPECT_TRUE(planner.GetPath().empty());
+        EXPECT_EQ(planner.GetSettledCount(), 0);
+    }
+    ch_planner.Search();
+    EXPECT_TRUE(ch_planner.GetPath().empty());
+    EXPECT_EQ(ch_planner.GetSettledCount(), 0);
+
+    std::mt19937 rng{29};
+    std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+    for (int query = 0; query < 32; ++query) {
+        float start_x = coordinate(rng), start_y = coordinate(rng), end_x = coordinate(rng), end_y = coordinate(rng);
+        float x = start_x * 0.01f, y = start_y * 0.01f;
+        Model::Node input{x, y};
+        float expected = std::numeric_limits<float>::infinity();
+        for (int node = 0; node < graph.NodeCount(); ++node)
+            if (components.Of(node) == 0)
+                expected = std::min(expected, RouteModel::Distance(input, nodes[node]));
+        RouteModel::Node closest = model.FindClosestNode(x, y, RouteModel::SnapScope::LargestComponent);
+        EXPECT_EQ(components.Of(closest.Index()), 0);
+        EXPECT_NEAR(RouteModel::Distance(input, closest.Position()), expected, 1e-6);
+        EdgePoint point = model.SnapToEdge(x, y, RouteModel::SnapScope::LargestComponent);
+        EXPECT_EQ(components.Of(point.from), 0);
+        EXPECT_LE(point.distance, expected + 1e-6f);
+
+        for (auto snap : {RoutePlanner::Snap::Node, RoutePlanner::Snap::Edge}) {
+            RoutePlanner anywhere{model, start_x, start_y, end_x, end_y, snap, RouteModel::SnapScope::LargestComponent};
+            anywhere.AStarSearch();
+            EXPECT_FALSE(anywhere.GetPath().empty());
+        }
+    }
+}
+
+// Queries share one read-only model, each thread searching with its own workspace.
+TEST(RoutePlannerGraphTest, ConcurrentQueriesMatchSequential) {
+    MappedFile osm_data = ReadOSMData("../map.osm");
+    const RouteModel model{osm_data};
+    std::mt19937 rng{11};
+    std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+    std::vector<std::array<float, 4>> queries(32);
+    for (auto &query : queries)
+        query = {coordinate(rng), coordinate(rng), coordinate(rng), coordinate(rng)};
+
+    std::vector<float> expected;
+    for (auto &[start_x, start_y, end_x, end_y] : queries) {
+        RoutePlanner planner{model, start_x, start_y, end_x, end_y};
+        planner.AStarSearch();
+        expected.push_back(planner.GetDistance());
+    }
+
+    const int thread_count = 4;
+    std::vector<float> distances(queries.size());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+        threads.emplace_back([&, t] {
+            SearchWorkspace workspace;
+            for (size_t i = t; i < queries.size(); i += thread_count) {
+                auto &[start_x, start_y, end_x, end_y] = queries[i];
+                RoutePlanner planner{model, workspace, start_x, start_y, end_x, end_y};
+                planner.AStarSearch();
+                distances[i] = planner.GetDistance();
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+    EXPECT_EQ(distances, expected);
 }